@@ -1,23 +1,76 @@
 #include <utility>
 #include "ast.h"
-#include "codegen_visitor.h"
+#include "ast_visitor.h"
+
+namespace {
+
+void deleteAll(std::vector<Rubiee::Expr*> &exprs) {
+    for (auto expr = exprs.begin(); expr != exprs.end(); ++expr) {
+        delete *expr;
+    }
+}
+
+}
 
 void Rubiee::Expr::accept(ASTNodeVisitor &visitor) {}
 void Rubiee::Statement::accept(ASTNodeVisitor &visitor) {}
 
-Rubiee::IntConst::IntConst(int val) : val(val) {};
+Rubiee::IntConst::IntConst(long long val) : val(val) {};
 
 void Rubiee::IntConst::accept(ASTNodeVisitor &visitor) {
     visitor.visit(*this);
 }
 
+Rubiee::FloatConst::FloatConst(double val) : val(val) {};
+
+void Rubiee::FloatConst::accept(ASTNodeVisitor &visitor) {
+    visitor.visit(*this);
+}
+
 Rubiee::ForLoopExpr::ForLoopExpr(Expr *start_expr, Expr *continue_condition, Expr *step_expr, std::vector<Expr*> body_exprs) 
-                                 : start_expr(start_expr), continue_condition(continue_condition), step_expr(step_expr), body_exprs(body_exprs) {};
+                                 : start_expr(start_expr), continue_condition(continue_condition), step_expr(step_expr), body_exprs(body_exprs), end_line(0) {};
+
+Rubiee::ForLoopExpr::~ForLoopExpr() {
+    delete start_expr;
+    delete continue_condition;
+    delete step_expr;
+    deleteAll(body_exprs);
+}
 
 void Rubiee::ForLoopExpr::accept(ASTNodeVisitor &visitor) {
     visitor.visit(*this);
 }
 
+Rubiee::Block::Block(std::vector<std::string> params, std::vector<Expr*> body_exprs) 
+                     : params(std::move(params)), body_exprs(std::move(body_exprs)), end_line(0) {};
+
+Rubiee::Block::~Block() {
+    deleteAll(body_exprs);
+}
+
+Rubiee::RangeLoopExpr::RangeLoopExpr(Expr *first, Expr *last, bool exclusive, Block *block) 
+                                     : first(first), last(last), exclusive(exclusive), block(block) {};
+
+Rubiee::RangeLoopExpr::~RangeLoopExpr() {
+    delete first;
+    delete last;
+    delete block;
+}
+
+void Rubiee::RangeLoopExpr::accept(ASTNodeVisitor &visitor) {
+    visitor.visit(*this);
+}
+
+Rubiee::YieldExpr::YieldExpr(std::vector<Expr*> args) : args(std::move(args)) {};
+
+Rubiee::YieldExpr::~YieldExpr() {
+    deleteAll(args);
+}
+
+void Rubiee::YieldExpr::accept(ASTNodeVisitor &visitor) {
+    visitor.visit(*this);
+}
+
 Rubiee::Variable::Variable(std::string name) : name(name) {};
 
 void Rubiee::Variable::accept(ASTNodeVisitor &visitor) {
@@ -27,6 +80,11 @@ void Rubiee::Variable::accept(ASTNodeVisitor &visitor) {
 Rubiee::VariableAssignment::VariableAssignment(Variable *var, Expr *expr) 
                                                : var(var), expr(expr) {};
 
+Rubiee::VariableAssignment::~VariableAssignment() {
+    delete var;
+    delete expr;
+}
+
 void Rubiee::VariableAssignment::accept(ASTNodeVisitor &visitor) {
     visitor.visit(*this);
 }
@@ -34,6 +92,11 @@ void Rubiee::VariableAssignment::accept(ASTNodeVisitor &visitor) {
 Rubiee::BinaryExpr::BinaryExpr(Expr *leftOperand, Expr *rightOperand, char op) 
                 : leftOperand(leftOperand), rightOperand(rightOperand), op(op) {};
 
+Rubiee::BinaryExpr::~BinaryExpr() {
+    delete leftOperand;
+    delete rightOperand;
+}
+
 void Rubiee::BinaryExpr::accept(ASTNodeVisitor &visitor) {
     visitor.visit(*this);
 }
@@ -41,6 +104,11 @@ void Rubiee::BinaryExpr::accept(ASTNodeVisitor &visitor) {
 Rubiee::ComparisonExpr::ComparisonExpr(Expr *leftOperand, Expr *rightOperand, std::string op) 
                                        : leftOperand(leftOperand), rightOperand(rightOperand), op(op) {};
 
+Rubiee::ComparisonExpr::~ComparisonExpr() {
+    delete leftOperand;
+    delete rightOperand;
+}
+
 void Rubiee::ComparisonExpr::accept(ASTNodeVisitor &visitor) {
     visitor.visit(*this);
 }
@@ -48,17 +116,53 @@ void Rubiee::ComparisonExpr::accept(ASTNodeVisitor &visitor) {
 Rubiee::IfExpr::IfExpr(Expr *condition, std::vector<Expr*> then_exprs, std::vector<Expr*> else_exprs) 
                        : condition(condition), then_exprs(then_exprs), else_exprs(else_exprs) {};
 
+Rubiee::IfExpr::~IfExpr() {
+    delete condition;
+    deleteAll(then_exprs);
+    deleteAll(else_exprs);
+}
+
 void Rubiee::IfExpr::accept(ASTNodeVisitor &visitor) {
     visitor.visit(*this);
 }
 
-Rubiee::FunctionCall::FunctionCall(std::string callee, std::vector<Expr*> args) 
-                                   : callee(callee), args(args) {};
+Rubiee::WhenClause::WhenClause(std::vector<Expr*> values, std::vector<Expr*> body_exprs) 
+                               : values(std::move(values)), body_exprs(std::move(body_exprs)) {};
+
+Rubiee::CaseExpr::CaseExpr(Expr *subject, std::vector<WhenClause> whens, std::vector<Expr*> else_exprs) 
+                           : subject(subject), whens(std::move(whens)), else_exprs(std::move(else_exprs)) {};
+
+Rubiee::CaseExpr::~CaseExpr() {
+    delete subject;
+    for (auto when = whens.begin(); when != whens.end(); ++when) {
+        deleteAll(when->values);
+        deleteAll(when->body_exprs);
+    }
+    deleteAll(else_exprs);
+}
+
+void Rubiee::CaseExpr::accept(ASTNodeVisitor &visitor) {
+    visitor.visit(*this);
+}
+
+Rubiee::FunctionCall::FunctionCall(std::string callee, std::vector<Expr*> args, Block *block) 
+                                   : callee(callee), args(args), block(block) {};
+
+Rubiee::FunctionCall::~FunctionCall() {
+    deleteAll(args);
+    delete block;
+}
 
 void Rubiee::FunctionCall::accept(ASTNodeVisitor &visitor) {
     visitor.visit(*this);
 }
 
+Rubiee::Require::Require(std::string path) : path(path) {};
+
+void Rubiee::Require::accept(ASTNodeVisitor &visitor) {
+    visitor.visit(*this);
+}
+
 Rubiee::FunctionPrototype::FunctionPrototype(std::string name, std::vector<std::string> args) 
                                              : name(name), args(std::move(args)) {};
 
@@ -68,12 +172,21 @@ void Rubiee::FunctionPrototype::accept(ASTNodeVisitor &visitor) {
 
 Rubiee::TopLevelExpr::TopLevelExpr(Expr *expr) : expr(expr) {};
 
+Rubiee::TopLevelExpr::~TopLevelExpr() {
+    delete expr;
+}
+
 void Rubiee::TopLevelExpr::accept(ASTNodeVisitor &visitor) {
     visitor.visit(*this);
 }
 
-Rubiee::Function::Function(FunctionPrototype *proto, Expr *body)
-                           : proto(proto), body(body) {};
+Rubiee::Function::Function(FunctionPrototype *proto, std::vector<Expr*> body_exprs, bool memo)
+                           : proto(proto), body_exprs(std::move(body_exprs)), memo(memo) {};
+
+Rubiee::Function::~Function() {
+    delete proto;
+    deleteAll(body_exprs);
+}
 
 void Rubiee::Function::accept(ASTNodeVisitor &visitor) {
     visitor.visit(*this);
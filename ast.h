@@ -8,10 +8,15 @@ namespace Rubiee {
   
 class ASTNodeVisitor;
 
+// Nodes own the nodes under them, and delete them with themselves
 class ASTNode {
 public:
+  ASTNode() : line(0) {}
   virtual ~ASTNode() = default;
   virtual void accept(ASTNodeVisitor &visitor) = 0;
+
+  // Source line the node starts at, `0` if unknown
+  int line;
 };
 
 class Expr : public ASTNode {
@@ -26,10 +31,18 @@ public:
 
 class IntConst : public Expr {
 public:
-  IntConst(int val);
+  IntConst(long long val);
+  void accept(ASTNodeVisitor &visitor);
+
+  long long val;
+};
+
+class FloatConst : public Expr {
+public:
+  FloatConst(double val);
   void accept(ASTNodeVisitor &visitor);
 
-  int val;
+  double val;
 };
 
 class BinaryExpr : public Expr {
@@ -37,6 +50,7 @@ public:
   BinaryExpr(Expr *leftOperand,
              Expr *rightOperand,
              char op);
+  ~BinaryExpr();
 
   void accept(ASTNodeVisitor &visitor);
 
@@ -49,6 +63,7 @@ public:
   ComparisonExpr(Expr *leftOperand,
                  Expr *rightOperand,
                  std::string op);
+  ~ComparisonExpr();
   void accept(ASTNodeVisitor &visitor);
 
   Expr *leftOperand, *rightOperand;
@@ -58,6 +73,7 @@ public:
 class IfExpr : public Expr {
 public:
   IfExpr(Expr *condition, std::vector<Expr*> then_exprs, std::vector<Expr*> else_exprs);
+  ~IfExpr();
   void accept(ASTNodeVisitor &visitor);
 
   Expr *condition;
@@ -65,13 +81,72 @@ public:
   std::vector<Expr*> else_exprs;
 };
 
+// One `when v1, v2, ... body end` branch of a `case`
+class WhenClause {
+public:
+  WhenClause(std::vector<Expr*> values, std::vector<Expr*> body_exprs);
+
+  std::vector<Expr*> values;
+  std::vector<Expr*> body_exprs;
+};
+
+class CaseExpr : public Expr {
+public:
+  CaseExpr(Expr *subject, std::vector<WhenClause> whens, std::vector<Expr*> else_exprs);
+  // Deletes the expressions of `whens` too, which are copied around
+  ~CaseExpr();
+  void accept(ASTNodeVisitor &visitor);
+
+  Expr *subject;
+  std::vector<WhenClause> whens;
+  std::vector<Expr*> else_exprs;
+};
+
 class ForLoopExpr : public Expr {
 public:
   ForLoopExpr(Expr *start_expr, Expr *continue_condition, Expr *step_expr, std::vector<Expr*> body_exprs);
+  ~ForLoopExpr();
   void accept(ASTNodeVisitor &visitor);
 
   Expr *start_expr, *continue_condition, *step_expr;
   std::vector<Expr*> body_exprs;
+  // Source line of the closing `end`
+  int end_line;
+};
+
+// A `do |params| body end` block, passed to an iterator or to a function
+// which `yield`s to it
+class Block {
+public:
+  Block(std::vector<std::string> params, std::vector<Expr*> body_exprs);
+  ~Block();
+
+  std::vector<std::string> params;
+  std::vector<Expr*> body_exprs;
+  // Source line of the closing `end`
+  int end_line;
+};
+
+// `n.times do |i| ... end` and `(a..b).each do |i| ... end`, which count from
+// `first` to `last`, `last` excluded for `times` and `...` ranges
+class RangeLoopExpr : public Expr {
+public:
+  RangeLoopExpr(Expr *first, Expr *last, bool exclusive, Block *block);
+  ~RangeLoopExpr();
+  void accept(ASTNodeVisitor &visitor);
+
+  Expr *first, *last;
+  bool exclusive;
+  Block *block;
+};
+
+class YieldExpr : public Expr {
+public:
+  YieldExpr(std::vector<Expr*> args);
+  ~YieldExpr();
+  void accept(ASTNodeVisitor &visitor);
+
+  std::vector<Expr*> args;
 };
 
 class Variable : public Expr {
@@ -85,6 +160,7 @@ public:
 class VariableAssignment : public Expr {
 public:
   VariableAssignment(Variable *var, Expr *expr);
+  ~VariableAssignment();
   void accept(ASTNodeVisitor &visitor);
 
   Variable *var;
@@ -93,11 +169,24 @@ public:
 
 class FunctionCall : public Expr {
 public:
-  FunctionCall(std::string callee, std::vector<Expr*> args);
+  FunctionCall(std::string callee, std::vector<Expr*> args, Block *block = nullptr);
+  ~FunctionCall();
   void accept(ASTNodeVisitor &visitor);
 
   std::string callee;
   std::vector<Expr*> args;
+  // Block given to the call, `nullptr` if there is none
+  Block *block;
+};
+
+class Require : public Expr {
+public:
+  Require(std::string path);
+  void accept(ASTNodeVisitor &visitor);
+
+  std::string path;
+  // Entry function of the required file, set once the file is resolved
+  std::string symbol;
 };
 
 class FunctionPrototype : public Statement {
@@ -112,6 +201,7 @@ public:
 class TopLevelExpr : public Statement {
 public:
   TopLevelExpr(Expr *expr);
+  ~TopLevelExpr();
   void accept(ASTNodeVisitor &visitor);
 
   Expr *expr;
@@ -119,11 +209,14 @@ public:
 
 class Function : public Statement {
 public:
-  Function(FunctionPrototype *proto, Expr *body);
+  Function(FunctionPrototype *proto, std::vector<Expr*> body_exprs, bool memo = false);
+  ~Function();
   void accept(ASTNodeVisitor &visitor);
 
   FunctionPrototype *proto;
-  Expr *body;
+  std::vector<Expr*> body_exprs;
+  // Declared with `memo def`, results should be cached
+  bool memo;
 };
   
 }
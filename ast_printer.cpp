@@ -0,0 +1,156 @@
+#include "ast_printer.h"
+#include "runtime.h"
+
+Rubiee::ASTPrinter::ASTPrinter(std::ostream &out) : out(out) {}
+
+void Rubiee::ASTPrinter::printExprs(const char *head, std::vector<Expr*> &exprs) {
+    out << "(" << head;
+    for (auto expr = exprs.begin(); expr != exprs.end(); ++expr) {
+        if (*head || expr != exprs.begin()) {
+            out << " ";
+        }
+        (*expr)->accept(*this);
+    }
+    out << ")";
+}
+
+void Rubiee::ASTPrinter::printBlock(Block &block) {
+    out << "(block (";
+    for (unsigned i = 0; i < block.params.size(); i++) {
+        out << (i ? " " : "") << block.params[i];
+    }
+    out << ") ";
+    printExprs("do", block.body_exprs);
+    out << ")";
+}
+
+void Rubiee::ASTPrinter::visit(Expr &expr) {}
+void Rubiee::ASTPrinter::visit(Statement &stmt) {}
+
+void Rubiee::ASTPrinter::visit(IntConst &int_const) {
+    out << int_const.val;
+}
+
+void Rubiee::ASTPrinter::visit(FloatConst &float_const) {
+    out << formatDouble(float_const.val);
+}
+
+void Rubiee::ASTPrinter::visit(BinaryExpr &binary_expr) {
+    out << "(" << binary_expr.op << " ";
+    binary_expr.leftOperand->accept(*this);
+    out << " ";
+    binary_expr.rightOperand->accept(*this);
+    out << ")";
+}
+
+void Rubiee::ASTPrinter::visit(ComparisonExpr &comparison_expr) {
+    out << "(" << comparison_expr.op << " ";
+    comparison_expr.leftOperand->accept(*this);
+    out << " ";
+    comparison_expr.rightOperand->accept(*this);
+    out << ")";
+}
+
+void Rubiee::ASTPrinter::visit(IfExpr &if_expr) {
+    out << "(if ";
+    if_expr.condition->accept(*this);
+    out << " ";
+    printExprs("then", if_expr.then_exprs);
+    out << " ";
+    printExprs("else", if_expr.else_exprs);
+    out << ")";
+}
+
+void Rubiee::ASTPrinter::visit(CaseExpr &case_expr) {
+    out << "(case ";
+    case_expr.subject->accept(*this);
+    for (auto when = case_expr.whens.begin(); when != case_expr.whens.end(); ++when) {
+        out << " (when ";
+        printExprs("", when->values);
+        out << " ";
+        printExprs("do", when->body_exprs);
+        out << ")";
+    }
+    out << " ";
+    printExprs("else", case_expr.else_exprs);
+    out << ")";
+}
+
+void Rubiee::ASTPrinter::visit(ForLoopExpr &for_loop_expr) {
+    out << "(for ";
+    for_loop_expr.start_expr->accept(*this);
+    out << " ";
+    for_loop_expr.continue_condition->accept(*this);
+    out << " ";
+    for_loop_expr.step_expr->accept(*this);
+    out << " ";
+    printExprs("do", for_loop_expr.body_exprs);
+    out << ")";
+}
+
+void Rubiee::ASTPrinter::visit(RangeLoopExpr &range_loop_expr) {
+    out << "(each (" << (range_loop_expr.exclusive ? "..." : "..") << " ";
+    range_loop_expr.first->accept(*this);
+    out << " ";
+    range_loop_expr.last->accept(*this);
+    out << ") ";
+    printBlock(*range_loop_expr.block);
+    out << ")";
+}
+
+void Rubiee::ASTPrinter::visit(YieldExpr &yield_expr) {
+    printExprs("yield", yield_expr.args);
+}
+
+void Rubiee::ASTPrinter::visit(Variable &var) {
+    out << var.name;
+}
+
+void Rubiee::ASTPrinter::visit(VariableAssignment &var_assignment) {
+    out << "(= ";
+    var_assignment.var->accept(*this);
+    out << " ";
+    var_assignment.expr->accept(*this);
+    out << ")";
+}
+
+void Rubiee::ASTPrinter::visit(FunctionCall &function_call) {
+    if (!function_call.block) {
+        printExprs(("call " + function_call.callee).c_str(), function_call.args);
+        return;
+    }
+
+    out << "(call " << function_call.callee;
+    for (auto arg = function_call.args.begin(); arg != function_call.args.end(); ++arg) {
+        out << " ";
+        (*arg)->accept(*this);
+    }
+    out << " ";
+    printBlock(*function_call.block);
+    out << ")";
+}
+
+void Rubiee::ASTPrinter::visit(Require &require) {
+    out << "(require \"" << require.path << "\")";
+}
+
+void Rubiee::ASTPrinter::visit(FunctionPrototype &function_prototype) {
+    out << function_prototype.name << " (";
+    for (unsigned i = 0; i < function_prototype.args.size(); i++) {
+        out << (i ? " " : "") << function_prototype.args[i];
+    }
+    out << ")";
+}
+
+void Rubiee::ASTPrinter::visit(TopLevelExpr &top_level_expr) {
+    top_level_expr.expr->accept(*this);
+    out << "\n";
+}
+
+void Rubiee::ASTPrinter::visit(Function &function) {
+    out << (function.memo ? "(memo def " : "(def ");
+    function.proto->accept(*this);
+    out << " ";
+    printExprs("do", function.body_exprs);
+    out << ")\n";
+}
@@ -0,0 +1,46 @@
+#ifndef __AST_PRINTER_H__
+#define __AST_PRINTER_H__ 1
+
+#include <ostream>
+#include "ast.h"
+#include "ast_visitor.h"
+
+namespace Rubiee {
+
+// Prints the AST as one S-expression per top level node, e.g.
+// `(= x (+ 1 (* 2 3)))`. The output of both front ends can be diffed to
+// check that they build identical ASTs.
+class ASTPrinter : public ASTNodeVisitor {
+
+public:
+    ASTPrinter(std::ostream &out);
+
+    void visit(Expr &expr);
+    void visit(Statement &stmt);
+    void visit(IntConst &int_const);
+    void visit(FloatConst &float_const);
+    void visit(BinaryExpr &binary_expr);
+    void visit(ComparisonExpr &comparison_expr);
+    void visit(IfExpr &if_expr);
+    void visit(CaseExpr &case_expr);
+    void visit(ForLoopExpr &for_loop_expr);
+    void visit(RangeLoopExpr &range_loop_expr);
+    void visit(YieldExpr &yield_expr);
+    void visit(Variable &var);
+    void visit(VariableAssignment &var_assignment);
+    void visit(FunctionCall &function_call);
+    void visit(Require &require);
+    void visit(FunctionPrototype &function_prototype);
+    void visit(TopLevelExpr &top_level_expr);
+    void visit(Function &function);
+
+private:
+    std::ostream &out;
+
+    void printExprs(const char *head, std::vector<Expr*> &exprs);
+    void printBlock(Block &block);
+};
+
+}
+
+#endif
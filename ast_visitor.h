@@ -0,0 +1,34 @@
+#ifndef __AST_VISITOR_H__
+#define __AST_VISITOR_H__ 1
+
+#include "ast.h"
+
+namespace Rubiee {
+
+class ASTNodeVisitor {
+
+public:
+    virtual ~ASTNodeVisitor() = default;
+    virtual void visit(Expr &expr) = 0;
+    virtual void visit(Statement &stmt) = 0;
+    virtual void visit(IntConst &int_const) = 0;
+    virtual void visit(FloatConst &float_const) = 0;
+    virtual void visit(BinaryExpr &binary_expr) = 0;
+    virtual void visit(ComparisonExpr &comparison_expr) = 0;
+    virtual void visit(IfExpr &if_expr) = 0;
+    virtual void visit(CaseExpr &case_expr) = 0;
+    virtual void visit(ForLoopExpr &for_loop_expr) = 0;
+    virtual void visit(RangeLoopExpr &range_loop_expr) = 0;
+    virtual void visit(YieldExpr &yield_expr) = 0;
+    virtual void visit(Variable &var) = 0;
+    virtual void visit(VariableAssignment &var_assignment) = 0;
+    virtual void visit(FunctionCall &function_call) = 0;
+    virtual void visit(Require &require) = 0;
+    virtual void visit(FunctionPrototype &function_prototype) = 0;
+    virtual void visit(TopLevelExpr &top_level_expr) = 0;
+    virtual void visit(Function &function) = 0;
+};
+
+}
+
+#endif
\ No newline at end of file
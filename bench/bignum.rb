@@ -0,0 +1,5 @@
+x = 3
+for i = 0; i < 16; i = i + 1
+  x = x * x
+end
+puts(x)
@@ -0,0 +1,5 @@
+sum = 0
+for i = 0; i < 300000000; i = i + 1
+  sum = sum + i * 3 - i + 7
+end
+puts(sum)
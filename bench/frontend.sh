@@ -0,0 +1,31 @@
+#!/bin/bash
+# Time both front ends on a large generated script, run by `make bench`.
+# The script has every construct, `$1` blocks of them (40000 by default).
+# Fails unless the Pratt parser is faster than the Bison parser.
+
+source=$(mktemp /tmp/rubiee-frontend.XXXXXX)
+trap 'rm -f "$source"' EXIT
+
+awk -v n="${1:-40000}" 'BEGIN {
+    for (i = 0; i < n; i++) {
+        printf "a%d = b * %d + 1\n", i, i
+        printf "if a%d < b * %d + 1\n  a%d = a%d + b - %d\nelse\n", i, i, i, i, i
+        printf "  b = b * 2 - a%d\nend\n", i
+        printf "for i = 0; i < 3; i = i + 1\n  a%d = a%d + read_int(i)\nend\n", i, i
+        printf "puts(a%d, b)\n", i
+    }
+}' > "$source"
+
+TIMEFORMAT=%R
+bison_time=$( { time ./main --parse-only "$source" > /dev/null 2>&1; } 2>&1 )
+pratt_time=$( { time ./main --pratt --parse-only "$source" > /dev/null 2>&1; } 2>&1 )
+
+echo "$(wc -l < "$source") lines"
+echo "  bison     ${bison_time}s"
+echo "  pratt     ${pratt_time}s"
+speedup=$(awk -v b="$bison_time" -v p="$pratt_time" 'BEGIN { printf "%.1f", (p > 0 ? b / p : 0) }')
+echo "  speedup   ${speedup}x"
+if ! awk -v b="$bison_time" -v p="$pratt_time" 'BEGIN { exit !(p < b) }'; then
+    echo "FAIL bench/frontend.sh: the Pratt parser is not faster"
+    exit 1
+fi
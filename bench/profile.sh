@@ -0,0 +1,45 @@
+#!/bin/bash
+# Time a loop-heavy script with and without --profile, run by `make bench`.
+# Fails if profiling makes it more than 50% slower.
+
+dir=$(mktemp -d /tmp/rubiee-profile.XXXXXX)
+trap 'rm -rf "$dir"' EXIT
+
+cat > "$dir/loops.rb" <<'EOF'
+total = 0
+for i = 0; i < 20000; i = i + 1
+  for j = 0; j < 20000; j = j + 1
+    if j < i
+      total = total + i * j
+    else
+      total = total - j
+    end
+  end
+end
+puts(total)
+EOF
+
+# The fastest of three runs
+fastest() {
+    local best=""
+    for run in 1 2 3; do
+        local t=$( { time ./main "$@" "$dir/loops.rb" > /dev/null 2>&1; } 2>&1 )
+        if [ -z "$best" ] || awk -v t="$t" -v b="$best" 'BEGIN { exit !(t < b) }'; then
+            best=$t
+        fi
+    done
+    echo "$best"
+}
+
+TIMEFORMAT=%R
+plain_time=$(fastest)
+profile_time=$(fastest --profile)
+
+echo "  plain     ${plain_time}s"
+echo "  profile   ${profile_time}s"
+overhead=$(awk -v p="$plain_time" -v q="$profile_time" 'BEGIN { printf "%.0f", (p > 0 ? 100 * (q - p) / p : 0) }')
+echo "  overhead  ${overhead}%"
+if [ "$overhead" -gt 50 ]; then
+    echo "FAIL bench/profile.sh: profiling costs more than 50%"
+    exit 1
+fi
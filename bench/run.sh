@@ -0,0 +1,56 @@
+#!/bin/bash
+# Run every benchmark with and without overflow checks, then the front end
+# and profiling benchmarks, run by `make bench`.
+#
+# bench/<name>.rb must print bench/<name>.out when checked. bignum.rb squares
+# its way up to 3 ** 65536, whose large products use Karatsuba. fixnum.rb
+# never leaves 64 bits, so its wrapping run prints the same, and the overflow
+# checks are all the difference between both runs: the checked run may be at
+# most MAX_OVERHEAD percent slower. Its loop is nothing but arithmetic, which
+# LLVM folds when it may wrap, so the checks cost it about 300%.
+
+MAX_OVERHEAD=${MAX_OVERHEAD:-500}
+
+output=$(mktemp /tmp/rubiee-bench.XXXXXX)
+trap 'rm -f "$output"' EXIT
+
+failures=0
+TIMEFORMAT=%R
+
+for script in bench/*.rb; do
+    expected="${script%.rb}.out"
+    echo "$script"
+
+    checked_time=$( { time ./main "$script" > "$output"; } 2>&1 )
+    echo "  checked   ${checked_time}s"
+    if ! cmp -s "$output" "$expected"; then
+        echo "FAIL $script: unexpected output"
+        failures=$((failures + 1))
+        continue
+    fi
+
+    wrapping_time=$( { time ./main --wrapping-integers "$script" > "$output"; } 2>&1 )
+    echo "  wrapping  ${wrapping_time}s"
+    if ! cmp -s "$output" "$expected"; then
+        continue
+    fi
+
+    overhead=$(awk -v c="$checked_time" -v w="$wrapping_time" 'BEGIN { printf "%.1f", (w > 0 ? 100 * (c - w) / w : 0) }')
+    echo "  overhead  ${overhead}%"
+    if awk -v o="$overhead" -v max="$MAX_OVERHEAD" 'BEGIN { exit !(o > max) }'; then
+        echo "FAIL $script: overflow checks cost more than ${MAX_OVERHEAD}%"
+        failures=$((failures + 1))
+    fi
+done
+
+for bench in bench/frontend.sh bench/profile.sh; do
+    echo "$bench"
+    if ! $bench; then
+        failures=$((failures + 1))
+    fi
+done
+
+if [ $failures -ne 0 ]; then
+    echo "$failures benchmark(s) failed"
+    exit 1
+fi
@@ -0,0 +1,44 @@
+#include "builtins.h"
+#include "runtime.h"
+
+// Address of a runtime function, functions and data pointers are the same
+// size on every target LLVM JITs for
+#define RUNTIME(fn) reinterpret_cast<void *>(&fn)
+
+const std::vector<Rubiee::Builtin> &Rubiee::builtins() {
+    static const std::vector<Builtin> table = {
+        { "puts", "_puts", INT32, {}, true, RUNTIME(_puts), 0 },
+
+        // Integer input, see `stdlib_input.cpp`
+        { "read_int", "_read_int", INT32, { INT32 }, false, RUNTIME(_read_int), 0 },
+        { "has_int", "_has_int", INT32, { INT32 }, false, RUNTIME(_has_int), 0 },
+        { "read_ints", "_read_ints", INT32, { INT32 }, false, RUNTIME(_read_ints), 0 },
+        { "array_size", "_array_size", INT32, { INT32 }, false, RUNTIME(_array_size), 0 },
+        { "array_get", "_array_get", INT32, { INT32, INT32 }, false, RUNTIME(_array_get), 0 },
+        { "array_free", "_array_free", INT32, { INT32 }, false, RUNTIME(_array_free), 0 },
+
+        // Hash tables, see `stdlib_hash.cpp`
+        { "hash_new", "_hash_new", INT32, { INT64 }, false, RUNTIME(_hash_new), 0 },
+        { "hash_get", "_hash_get", INT64, { INT32, INT64 }, false, RUNTIME(_hash_get), 0 },
+        { "hash_has", "_hash_has", INT32, { INT32, INT64 }, false, RUNTIME(_hash_has), 0 },
+        { "hash_set", "_hash_set", INT64, { INT32, INT64, INT64 }, false, RUNTIME(_hash_set), 0 },
+        { "hash_delete", "_hash_delete", INT32, { INT32, INT64 }, false, RUNTIME(_hash_delete), 0 },
+        { "hash_size", "_hash_size", INT64, { INT32 }, false, RUNTIME(_hash_size), 0 },
+        { "hash_next", "_hash_next", INT64, { INT32, INT64 }, false, RUNTIME(_hash_next), 0 },
+        { "hash_key", "_hash_key", INT64, { INT32, INT64 }, false, RUNTIME(_hash_key), 0 },
+        { "hash_value", "_hash_value", INT64, { INT32, INT64 }, false, RUNTIME(_hash_value), 0 },
+        { "hash_stats", "_hash_stats", INT32, { INT32 }, false, RUNTIME(_hash_stats), 0 },
+        { "hash_free", "_hash_free", INT32, { INT32 }, false, RUNTIME(_hash_free), 0 },
+    };
+    return table;
+}
+
+const Rubiee::Builtin *Rubiee::findBuiltin(const std::string &name) {
+    const std::vector<Builtin> &table = builtins();
+    for (auto builtin = table.begin(); builtin != table.end(); ++builtin) {
+        if (name == builtin->name) {
+            return &*builtin;
+        }
+    }
+    return nullptr;
+}
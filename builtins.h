@@ -0,0 +1,38 @@
+#ifndef __BUILTINS_H__
+#define __BUILTINS_H__ 1
+
+#include <string>
+#include <vector>
+#include "type_inference.h"
+
+namespace Rubiee {
+
+enum BuiltinFlags {
+    // Reads and writes no memory, so callers can be memoized and calls with
+    // the same arguments merged
+    BUILTIN_PURE = 1 << 0,
+    // Rarely called, keep calls out of the way of the hot path
+    BUILTIN_COLD = 1 << 1
+};
+
+// A native function scripts can call by `name`: a runtime function, see
+// `runtime.h`, or a function of an embedding host, see `rubiee.h`
+struct Builtin {
+    std::string name;
+    std::string symbol;
+    NumericType return_type;
+    std::vector<NumericType> arg_types;
+    // Takes any number of arguments, only `puts` does
+    bool variadic;
+    // Bound to `symbol` in the JIT, calls are direct calls to it
+    void *address;
+    unsigned flags;
+};
+
+const std::vector<Builtin> &builtins();
+// Builtin called `name`, `nullptr` if there is none
+const Builtin *findBuiltin(const std::string &name);
+
+}
+
+#endif
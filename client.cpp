@@ -0,0 +1,94 @@
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "protocol.h"
+
+// A thin client for the compile server: submit a script, print what it
+// writes and exit with its status. Timing stats go to stderr. Options are
+// those of `main`, the server checks them.
+int main(int argc, char **argv)
+{
+    std::vector<std::string> options;
+    int arg = 1;
+    for (; arg < argc && argv[arg][0] == '-' && argv[arg][1] == '-'; arg++) {
+        options.push_back(argv[arg]);
+    }
+    if (argc - arg != 2) {
+        fprintf(stderr, "Usage: %s [options] <socket> <file>\n", argv[0]);
+        return 1;
+    }
+    const char *socket_path = argv[arg];
+    const char *script_path = argv[arg + 1];
+
+    std::ifstream source_file (script_path, std::ifstream::in);
+    if (!source_file) {
+        fprintf(stderr, "Cannot open `%s`.\n", script_path);
+        return 1;
+    }
+    std::stringstream source;
+    source << source_file.rdbuf();
+    source_file.close();
+
+    char path[PATH_MAX];
+    if (!realpath(script_path, path)) {
+        perror("realpath");
+        return 1;
+    }
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socket_path, sizeof(addr.sun_path) - 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+        perror("connect");
+        return 1;
+    }
+
+    for (auto option = options.begin(); option != options.end(); ++option) {
+        if (!Rubiee::Protocol::writeFrame(fd, Rubiee::Protocol::OPTION, *option)) {
+            perror("write");
+            return 1;
+        }
+    }
+    if (!Rubiee::Protocol::writeFrame(fd, Rubiee::Protocol::PATH, std::string(path)) ||
+        !Rubiee::Protocol::writeFrame(fd, Rubiee::Protocol::SCRIPT, source.str())) {
+        perror("write");
+        return 1;
+    }
+    shutdown(fd, SHUT_WR);
+
+    char type;
+    std::string payload;
+    while (Rubiee::Protocol::readFrame(fd, type, payload)) {
+        switch (type) {
+        case Rubiee::Protocol::OUTPUT:
+            fwrite(payload.data(), 1, payload.size(), stdout);
+            fflush(stdout);
+            break;
+        case Rubiee::Protocol::ERROR:
+        case Rubiee::Protocol::STATS:
+            fflush(stdout);
+            fwrite(payload.data(), 1, payload.size(), stderr);
+            break;
+        case Rubiee::Protocol::EXIT:
+            fflush(stdout);
+            close(fd);
+            return Rubiee::Protocol::decodeStatus(payload);
+        }
+    }
+
+    fprintf(stderr, "Connection to the server was lost.\n");
+    close(fd);
+    return 1;
+}
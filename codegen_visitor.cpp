@@ -1,43 +1,137 @@
 #include "codegen_visitor.h"
+#include "runtime.h"
+#include "builtins.h"
 #include "llvm/IR/Constants.h"
+#include "llvm/IR/Intrinsics.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/MDBuilder.h"
 #include "llvm/ADT/APInt.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/TargetSelect.h"
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/Transforms/IPO.h"
+#include "llvm/Transforms/Scalar.h"
+#include "llvm/Transforms/Scalar/GVN.h"
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <set>
+
+Rubiee::CodeGenVisitor::CodeGenVisitor() : CodeGenVisitor(createJIT()) {}
+
+Rubiee::CodeGenVisitor::CodeGenVisitor(std::shared_ptr<llvm::orc::KaleidoscopeJIT> jit) 
+                                       : builder(context), current_types(&type_inference.topLevel()),
+                                         inline_frame(nullptr), jit(std::move(jit)), 
+                                         memo_cache_bits(14), memo_stats(false), 
+                                         hash_tables(nullptr), hash_count(nullptr), overflow_checks(true),
+                                         profile(false), profile_line(nullptr), 
+                                         profile_depth(nullptr), profile_stack(nullptr), file_depth(nullptr) {
+    initModule(module, "jit", this->jit->getTargetMachine().createDataLayout());
+    initStandardLibraryFunctions();
+    initTopLevelExpr();
+};
 
-Rubiee::CodeGenVisitor::CodeGenVisitor() : builder(context) {
+Rubiee::CodeGenVisitor::CodeGenVisitor(const llvm::DataLayout &data_layout, std::string module_name, std::string entry_name)
+                                       : builder(context), current_types(&type_inference.topLevel()),
+                                         inline_frame(nullptr), memo_cache_bits(14), memo_stats(false), 
+                                         hash_tables(nullptr), hash_count(nullptr), overflow_checks(true),
+                                         profile(false), profile_line(nullptr), 
+                                         profile_depth(nullptr), profile_stack(nullptr), file_depth(nullptr) {
+    initModule(module, module_name, data_layout);
+    initStandardLibraryFunctions();
+    initRequireEntry(entry_name);
+    function_prefix = entry_name + ".";
+}
+
+std::unique_ptr<llvm::orc::KaleidoscopeJIT> Rubiee::CodeGenVisitor::createJIT() {
     llvm::InitializeNativeTarget();
     llvm::InitializeNativeTargetAsmPrinter();
     llvm::InitializeNativeTargetAsmParser();
 
-    jit = llvm::make_unique<llvm::orc::KaleidoscopeJIT>();
-    initModule(module, "jit");
-    initStandardLibraryFunctions();
-    initTopLevelExpr();
-};
+    auto jit = llvm::make_unique<llvm::orc::KaleidoscopeJIT>();
+    bindRuntimeSymbols(*jit);
+    return jit;
+}
 
-void Rubiee::CodeGenVisitor::initModule(std::unique_ptr<llvm::Module> &module, std::string module_name) {
+void Rubiee::CodeGenVisitor::initModule(std::unique_ptr<llvm::Module> &module, std::string module_name, const llvm::DataLayout &data_layout) {
     module = llvm::make_unique<llvm::Module>(module_name, context);
-    module->setDataLayout(jit->getTargetMachine().createDataLayout());
+    module->setDataLayout(data_layout);
 }
 
 void Rubiee::CodeGenVisitor::initStandardLibraryFunctions() {
-    // void _puts(int num, ...)
-    stdlib_functions["puts"] = llvm::Function::Create(
+    const std::vector<Builtin> &table = builtins();
+    for (auto builtin = table.begin(); builtin != table.end(); ++builtin) {
+        declareStandardLibraryFunction(*builtin);
+    }
+}
+
+void Rubiee::CodeGenVisitor::bindRuntimeSymbols(llvm::orc::KaleidoscopeJIT &jit) {
+    const std::vector<Builtin> &table = builtins();
+    for (auto builtin = table.begin(); builtin != table.end(); ++builtin) {
+        bindSymbol(jit, builtin->symbol, builtin->address);
+    }
+
+    bindSymbol(jit, "_bignum_add", reinterpret_cast<void *>(&_bignum_add));
+    bindSymbol(jit, "_bignum_sub", reinterpret_cast<void *>(&_bignum_sub));
+    bindSymbol(jit, "_bignum_mul", reinterpret_cast<void *>(&_bignum_mul));
+    bindSymbol(jit, "_bignum_compare", reinterpret_cast<void *>(&_bignum_compare));
+    bindSymbol(jit, "_bignum_to_double", reinterpret_cast<void *>(&_bignum_to_double));
+    bindSymbol(jit, "_bignum_from_double", reinterpret_cast<void *>(&_bignum_from_double));
+    bindSymbol(jit, "_bignum_keep", reinterpret_cast<void *>(&_bignum_keep));
+    bindSymbol(jit, "_bignum_range_error", reinterpret_cast<void *>(&_bignum_range_error));
+    bindSymbol(jit, "_rubiee_hash_tables", &_rubiee_hash_tables);
+    bindSymbol(jit, "_rubiee_hash_count", &_rubiee_hash_count);
+    bindSymbol(jit, "_rubiee_profile_line", const_cast<int *>(&_rubiee_profile_line));
+    bindSymbol(jit, "_rubiee_profile_depth", const_cast<int *>(&_rubiee_profile_depth));
+    bindSymbol(jit, "_rubiee_profile_stack", const_cast<const ProfileFrame **>(_rubiee_profile_stack));
+}
+
+void Rubiee::CodeGenVisitor::bindSymbol(llvm::orc::KaleidoscopeJIT &jit, const std::string &symbol, void *address) {
+    jit.defineSymbol(symbol, (llvm::JITTargetAddress) (uintptr_t) address);
+}
+
+void Rubiee::CodeGenVisitor::addHostFunction(const Builtin &builtin) {
+    host_functions[builtin.name] = builtin;
+    type_inference.addHostFunction(builtin.name, builtin.return_type);
+    declareStandardLibraryFunction(builtin);
+}
+
+const Rubiee::Builtin *Rubiee::CodeGenVisitor::findFunction(const std::string &name) {
+    auto host_function = host_functions.find(name);
+    return host_function != host_functions.end() ? &host_function->second : findBuiltin(name);
+}
+
+void Rubiee::CodeGenVisitor::declareStandardLibraryFunction(const Builtin &builtin) {
+    // void _puts(int num, ...) takes any number of arguments, other builtins
+    // take exactly their argument types
+    std::vector<llvm::Type *> arg_types;
+    if (builtin.variadic) {
+        arg_types.push_back(llvm::Type::getInt32Ty(context));
+    }
+    for (auto type = builtin.arg_types.begin(); type != builtin.arg_types.end(); ++type) {
+        arg_types.push_back(llvmType(*type));
+    }
+
+    stdlib_functions[builtin.name] = llvm::Function::Create(
         llvm::FunctionType::get(
-            llvm::Type::getVoidTy(context),
-            std::vector<llvm::Type *>(
-                1,
-                llvm::Type::getInt32Ty(context)
-            ),
-            true
+            builtin.variadic ? llvm::Type::getVoidTy(context) : llvmType(builtin.return_type),
+            arg_types,
+            builtin.variadic
         ),
         llvm::Function::ExternalLinkage,
-        "_puts",
+        builtin.symbol,
         module.get()
     );
+
+    llvm::Function *fn = stdlib_functions[builtin.name];
+    if (builtin.flags & BUILTIN_PURE) {
+        fn->addFnAttr(llvm::Attribute::ReadNone);
+        fn->addFnAttr(llvm::Attribute::NoUnwind);
+    }
+    if (builtin.flags & BUILTIN_COLD) {
+        fn->addFnAttr(llvm::Attribute::Cold);
+    }
 }
 
 void Rubiee::CodeGenVisitor::initTopLevelExpr() {
@@ -57,29 +151,337 @@ void Rubiee::CodeGenVisitor::initTopLevelExpr() {
     llvm::BasicBlock::Create(context, "entry", main_function);
 }
 
-void Rubiee::CodeGenVisitor::executeCode() {
+llvm::orc::KaleidoscopeJIT &Rubiee::CodeGenVisitor::getJIT() {
+    return *jit;
+}
+
+void Rubiee::CodeGenVisitor::setProfiling(std::string path) {
+    profile = true;
+    profile_path = path;
+
+    // int _rubiee_profile_line, _rubiee_profile_depth and
+    // const ProfileFrame *_rubiee_profile_stack[], defined in `profiler.cpp`
+    profile_line = new llvm::GlobalVariable(
+        *module,
+        llvm::Type::getInt32Ty(context),
+        false,
+        llvm::GlobalValue::ExternalLinkage,
+        nullptr,
+        "_rubiee_profile_line"
+    );
+    profile_depth = new llvm::GlobalVariable(
+        *module,
+        llvm::Type::getInt32Ty(context),
+        false,
+        llvm::GlobalValue::ExternalLinkage,
+        nullptr,
+        "_rubiee_profile_depth"
+    );
+    profile_stack = new llvm::GlobalVariable(
+        *module,
+        llvm::ArrayType::get(llvm::Type::getInt8PtrTy(context), PROFILE_STACK_SIZE + 1),
+        false,
+        llvm::GlobalValue::ExternalLinkage,
+        nullptr,
+        "_rubiee_profile_stack"
+    );
+
+    // The top level of a required file runs in a frame of its own
+    if (main_function->getName() != "main") {
+        builder.SetInsertPoint( &(main_function->back()) );
+        file_depth = pushFrame("require " + path, 0, 0);
+    }
+}
+
+void Rubiee::CodeGenVisitor::markLine(int line) {
+    if (!profile || line <= 0) {
+        return;
+    }
+
+    builder.CreateStore(
+        llvm::ConstantInt::get(context, llvm::APInt(32, line, true)),
+        profile_line,
+        true
+    );
+}
+
+llvm::Value *Rubiee::CodeGenVisitor::pushFrame(const std::string &name, int start_line, int end_line) {
+    if (!profile) {
+        return nullptr;
+    }
+
+    // A ProfileFrame constant, see `profiler.h`
+    llvm::Type *int_type = llvm::Type::getInt32Ty(context);
+    llvm::Constant *fields[] = {
+        builder.CreateGlobalStringPtr(profile_path, "frame_path"),
+        builder.CreateGlobalStringPtr(name, "frame_name"),
+        llvm::ConstantInt::get(int_type, start_line),
+        llvm::ConstantInt::get(int_type, end_line)
+    };
+    llvm::Constant *data = llvm::ConstantStruct::getAnon(context, fields);
+    llvm::GlobalVariable *frame = new llvm::GlobalVariable(
+        *module,
+        data->getType(),
+        true,
+        llvm::GlobalValue::PrivateLinkage,
+        data,
+        "frame"
+    );
+
+    // Frames past the end of the stack all go to its last slot
+    llvm::Value *depth = builder.CreateLoad(profile_depth, true, "depth");
+    llvm::Value *stack_size = llvm::ConstantInt::get(int_type, PROFILE_STACK_SIZE);
+    llvm::Value *slot = builder.CreateSelect(builder.CreateICmpULT(depth, stack_size), depth, stack_size);
+    llvm::Value *indices[] = { llvm::ConstantInt::get(int_type, 0), slot };
+    builder.CreateStore(
+        builder.CreatePointerCast(frame, llvm::Type::getInt8PtrTy(context)),
+        builder.CreateInBoundsGEP(profile_stack, indices),
+        true
+    );
+    builder.CreateStore(builder.CreateAdd(depth, llvm::ConstantInt::get(int_type, 1)), profile_depth, true);
+    return depth;
+}
+
+void Rubiee::CodeGenVisitor::popFrame(llvm::Value *depth) {
+    if (!profile) {
+        return;
+    }
+
+    builder.CreateStore(depth, profile_depth, true);
+}
+
+void Rubiee::CodeGenVisitor::initRequireEntry(std::string entry_name) {
+    // Top level expressions of a required file are placed at its entry
+    // function, a flag makes sure they only run once
+    llvm::GlobalVariable *loaded = new llvm::GlobalVariable(
+        *module,
+        llvm::Type::getInt1Ty(context),
+        false,
+        llvm::GlobalValue::InternalLinkage,
+        llvm::ConstantInt::getFalse(context),
+        "loaded"
+    );
+
+    main_function = llvm::Function::Create(
+        llvm::FunctionType::get(
+            llvm::Type::getInt32Ty(context),
+            std::vector<llvm::Type *>(0),
+            false
+        ),
+        llvm::Function::ExternalLinkage,
+        entry_name,
+        module.get()
+    );
+
+    llvm::BasicBlock *entry_block = llvm::BasicBlock::Create(context, "entry", main_function);
+    llvm::BasicBlock *loaded_block = llvm::BasicBlock::Create(context, "already_loaded", main_function);
+    llvm::BasicBlock *body_block = llvm::BasicBlock::Create(context, "body", main_function);
+
+    builder.SetInsertPoint(entry_block);
+    builder.CreateCondBr(builder.CreateLoad(loaded, "loaded"), loaded_block, body_block);
+
+    builder.SetInsertPoint(loaded_block);
+    builder.CreateRet(llvm::ConstantInt::get(context, llvm::APInt(32, 0, true)));
+
+    // Mark the file as loaded before running it, so cyclic requires stop here
+    builder.SetInsertPoint(body_block);
+    builder.CreateStore(llvm::ConstantInt::getTrue(context), loaded);
+}
+
+std::unique_ptr<llvm::Module> Rubiee::CodeGenVisitor::releaseModule() {
+    builder.SetInsertPoint( &(main_function->back()) );
+    if (file_depth) {
+        popFrame(file_depth);
+    }
+    builder.CreateRet(llvm::ConstantInt::get(context, llvm::APInt(32, 1, true)));
+
+    optimizeModule();
+    return std::move(module);
+}
+
+Rubiee::CodeGenVisitor::MainFunction Rubiee::CodeGenVisitor::compileCode() {
     // insert return instruction to the end of the main function
     builder.SetInsertPoint( &(main_function->back()) );
     builder.CreateRetVoid();
 
-    // Execute main function
-    jit->addModule(std::move(module));
+    optimizeModule();
+    module_handle = jit->addModule(std::move(module));
     auto symbol = jit->findSymbol("main");
-    void (*main_fn)() = (void (*)()) (intptr_t) symbol.getAddress();
+    return (MainFunction) (intptr_t) symbol.getAddress();
+}
+
+llvm::orc::KaleidoscopeJIT::ModuleHandleT Rubiee::CodeGenVisitor::moduleHandle() const {
+    return module_handle;
+}
+
+const std::vector<std::string> &Rubiee::CodeGenVisitor::memoCaches() const {
+    return memo_caches;
+}
+
+void Rubiee::CodeGenVisitor::optimizeModule() {
+    // Variables become registers first, so that the inliner sees the real size
+    // of functions, and the checks of integer arithmetic stay out of loops
+    llvm::legacy::PassManager passes;
+    passes.add(llvm::createPromoteMemoryToRegisterPass());
+    passes.add(llvm::createInstructionCombiningPass());
+    passes.add(llvm::createFunctionInliningPass());
+    passes.add(llvm::createInstructionCombiningPass());
+    passes.add(llvm::createJumpThreadingPass());
+    passes.add(llvm::createCorrelatedValuePropagationPass());
+    passes.add(llvm::createGVNPass());
+    passes.add(llvm::createLICMPass());
+    passes.add(llvm::createCFGSimplificationPass());
+    passes.run(*module);
+}
+
+void Rubiee::CodeGenVisitor::executeCode() {
+    // Execute main function
+    MainFunction main_fn = compileCode();
     main_fn();
 }
 
 void Rubiee::CodeGenVisitor::visit(Expr &expr) {}
 void Rubiee::CodeGenVisitor::visit(Statement &stmt) {}
 
+llvm::Type *Rubiee::CodeGenVisitor::llvmType(NumericType type) {
+    switch (type) {
+    case INT64: return llvm::Type::getInt64Ty(context);
+    case DOUBLE: return llvm::Type::getDoubleTy(context);
+    default: return llvm::Type::getInt32Ty(context);
+    }
+}
+
+Rubiee::NumericType Rubiee::CodeGenVisitor::typeOf(Expr *expr) {
+    auto type = current_types->exprs.find(expr);
+    return type == current_types->exprs.end() ? INT32 : type->second;
+}
+
+llvm::Value *Rubiee::CodeGenVisitor::convert(llvm::Value *value, NumericType type) {
+    llvm::Type *target = llvmType(type);
+    llvm::Type *source = value->getType();
+
+    if (source == target) {
+        return value;
+    }
+    if (source->isIntegerTy(1)) {
+        value = builder.CreateZExt(value, llvm::Type::getInt32Ty(context));
+        source = value->getType();
+        if (source == target) {
+            return value;
+        }
+    }
+
+    if (source->isDoubleTy()) {
+        if (!overflow_checks || !target->isIntegerTy(64)) {
+            return saturatingToInteger(value, target);
+        }
+
+        // Doubles outside of the fixnums, whose bounds are exact doubles,
+        // become bignums
+        llvm::Function *current_function = builder.GetInsertBlock()->getParent();
+        llvm::BasicBlock *fixnum_block = llvm::BasicBlock::Create(context, "double_to_fixnum", current_function);
+        llvm::BasicBlock *bignum_block = llvm::BasicBlock::Create(context, "double_to_bignum", current_function);
+        llvm::BasicBlock *end_block = llvm::BasicBlock::Create(context, "to_integer_end", current_function);
+        llvm::Value *fixnum = builder.CreateAnd(
+            builder.CreateFCmpOGE(value, llvm::ConstantFP::get(source, (double) RUBIEE_FIXNUM_MIN)),
+            builder.CreateFCmpOLT(value, llvm::ConstantFP::get(source, std::ldexp(1.0, 63)))
+        );
+        builder.CreateCondBr(fixnum, fixnum_block, bignum_block, likelyBranch());
+
+        builder.SetInsertPoint(fixnum_block);
+        llvm::Value *fixnum_value = builder.CreateFPToSI(value, target);
+        builder.CreateBr(end_block);
+
+        builder.SetInsertPoint(bignum_block);
+        llvm::Value *bignum_value = builder.CreateCall(bignumFunction("_bignum_from_double", target, { source }), { value });
+        builder.CreateBr(end_block);
+
+        builder.SetInsertPoint(end_block);
+        llvm::PHINode *phi_node = builder.CreatePHI(target, 2, "integer");
+        phi_node->addIncoming(fixnum_value, fixnum_block);
+        phi_node->addIncoming(bignum_value, bignum_block);
+        return phi_node;
+    }
+    if (target->isDoubleTy()) {
+        if (!overflow_checks || !source->isIntegerTy(64) || llvm::isa<llvm::Constant>(value)) {
+            return builder.CreateSIToFP(value, target);
+        }
+
+        // Bignums are converted by the runtime
+        llvm::Function *current_function = builder.GetInsertBlock()->getParent();
+        llvm::BasicBlock *fixnum_block = llvm::BasicBlock::Create(context, "fixnum_to_double", current_function);
+        llvm::BasicBlock *bignum_block = llvm::BasicBlock::Create(context, "bignum_to_double", current_function);
+        llvm::BasicBlock *end_block = llvm::BasicBlock::Create(context, "to_double_end", current_function);
+        builder.CreateCondBr(builder.CreateNot(isBignum(value)), fixnum_block, bignum_block, likelyBranch());
+
+        builder.SetInsertPoint(fixnum_block);
+        llvm::Value *fixnum_value = builder.CreateSIToFP(value, target);
+        builder.CreateBr(end_block);
+
+        builder.SetInsertPoint(bignum_block);
+        llvm::Value *bignum_value = builder.CreateCall(bignumFunction("_bignum_to_double", target, { source }), { value });
+        builder.CreateBr(end_block);
+
+        builder.SetInsertPoint(end_block);
+        llvm::PHINode *phi_node = builder.CreatePHI(target, 2, "double");
+        phi_node->addIncoming(fixnum_value, fixnum_block);
+        phi_node->addIncoming(bignum_value, bignum_block);
+        return phi_node;
+    }
+    return builder.CreateSExtOrTrunc(value, target);
+}
+
+llvm::Value *Rubiee::CodeGenVisitor::saturatingToInteger(llvm::Value *value, llvm::Type *target) {
+    // `fptosi` is undefined outside of the range of `target`, whose bounds are
+    // powers of two and therefore exact doubles
+    unsigned bits = target->getIntegerBitWidth();
+    llvm::Value *lower = llvm::ConstantFP::get(value->getType(), -std::ldexp(1.0, bits - 1));
+    llvm::Value *upper = llvm::ConstantFP::get(value->getType(), std::ldexp(1.0, bits - 1));
+    llvm::Value *result = builder.CreateSelect(
+        builder.CreateFCmpUNO(value, value),
+        llvm::ConstantInt::get(target, 0),
+        llvm::ConstantInt::get(target, llvm::APInt::getSignedMinValue(bits))
+    );
+    result = builder.CreateSelect(builder.CreateFCmpOGE(value, lower), builder.CreateFPToSI(value, target), result);
+    return builder.CreateSelect(
+        builder.CreateFCmpOGE(value, upper),
+        llvm::ConstantInt::get(target, llvm::APInt::getSignedMaxValue(bits)),
+        result,
+        "saturated"
+    );
+}
+
+llvm::Value *Rubiee::CodeGenVisitor::toCondition(llvm::Value *value) {
+    if (value->getType()->isIntegerTy(1)) {
+        return value;
+    }
+    if (value->getType()->isDoubleTy()) {
+        return builder.CreateFCmpONE(value, llvm::ConstantFP::get(value->getType(), 0.0), "cond");
+    }
+    return builder.CreateICmpNE(value, llvm::ConstantInt::get(value->getType(), 0), "cond");
+}
+
 void Rubiee::CodeGenVisitor::visit(IntConst &int_const) {
     generated_value = llvm::ConstantInt::getSigned(
-        llvm::Type::getInt32Ty(context),
+        llvmType(typeOf(&int_const)),
         int_const.val
     );
 }
 
+void Rubiee::CodeGenVisitor::visit(FloatConst &float_const) {
+    generated_value = llvm::ConstantFP::get(
+        llvm::Type::getDoubleTy(context),
+        float_const.val
+    );
+}
+
 void Rubiee::CodeGenVisitor::visit(BinaryExpr &binary_expr) {
+    NumericType type = typeOf(&binary_expr);
+    if (type == INT64 && overflow_checks) {
+        generated_value = generateCheckedArithmetic(binary_expr);
+        return;
+    }
+
     llvm::Value *lhs, *rhs;
 
     (binary_expr.leftOperand)->accept(*this);
@@ -93,6 +495,24 @@ void Rubiee::CodeGenVisitor::visit(BinaryExpr &binary_expr) {
         return;
     }
 
+    lhs = convert(lhs, type);
+    rhs = convert(rhs, type);
+
+    if (type == DOUBLE) {
+        switch(binary_expr.op) {
+        case '+':
+            generated_value = builder.CreateFAdd(lhs, rhs, "add");
+            break;
+        case '-':
+            generated_value = builder.CreateFSub(lhs, rhs, "sub");
+            break;
+        case '*':
+            generated_value = builder.CreateFMul(lhs, rhs, "mul");
+            break;
+        }
+        return;
+    }
+
     switch(binary_expr.op) {
     case '+':
         generated_value = builder.CreateAdd(lhs, rhs, "add");
@@ -106,6 +526,160 @@ void Rubiee::CodeGenVisitor::visit(BinaryExpr &binary_expr) {
     }
 }
 
+void Rubiee::CodeGenVisitor::collectOperands(Expr *expr, std::vector<Expr *> &operands) {
+    BinaryExpr *binary_expr = dynamic_cast<BinaryExpr *>(expr);
+    if (!binary_expr || typeOf(expr) != INT64) {
+        operands.push_back(expr);
+        return;
+    }
+    collectOperands(binary_expr->leftOperand, operands);
+    collectOperands(binary_expr->rightOperand, operands);
+}
+
+llvm::Value *Rubiee::CodeGenVisitor::generateCheckedArithmetic(BinaryExpr &binary_expr) {
+    llvm::Type *int64_type = llvm::Type::getInt64Ty(context);
+
+    // Operands are evaluated once, from left to right, and shared by both paths
+    std::vector<Expr *> operands;
+    collectOperands(&binary_expr, operands);
+    std::map<Expr *, llvm::Value *> values;
+    for (auto operand = operands.begin(); operand != operands.end(); ++operand) {
+        (*operand)->accept(*this);
+        if (!generated_value) {
+            return nullptr;
+        }
+        values[*operand] = convert(generated_value, INT64);
+    }
+
+    // The fast path is the plain instructions, with a single branch on their
+    // overflow flags and on operands which turn out to be bignums. Results
+    // which land among the handles go to the runtime as well, so that a bignum
+    // always has a single representation.
+    llvm::Value *slow = builder.getFalse();
+    for (auto operand = operands.begin(); operand != operands.end(); ++operand) {
+        if (!isFixnum(*operand)) {
+            slow = builder.CreateOr(slow, isBignum(values[*operand]));
+        }
+    }
+    llvm::Value *fast_value = generateArithmetic(&binary_expr, values, &slow);
+    slow = builder.CreateOr(slow, isBignum(fast_value));
+
+    llvm::Function *current_function = builder.GetInsertBlock()->getParent();
+    llvm::BasicBlock *fast_block = builder.GetInsertBlock();
+    llvm::BasicBlock *slow_block = llvm::BasicBlock::Create(context, "bignum", current_function);
+    llvm::BasicBlock *end_block = llvm::BasicBlock::Create(context, "arith_end", current_function);
+    builder.CreateCondBr(builder.CreateNot(slow), end_block, slow_block, likelyBranch());
+
+    builder.SetInsertPoint(slow_block);
+    llvm::Value *slow_value = generateArithmetic(&binary_expr, values, nullptr);
+    builder.CreateBr(end_block);
+
+    builder.SetInsertPoint(end_block);
+    llvm::PHINode *phi_node = builder.CreatePHI(int64_type, 2, "arith");
+    phi_node->addIncoming(fast_value, fast_block);
+    phi_node->addIncoming(slow_value, slow_block);
+    return phi_node;
+}
+
+llvm::Value *Rubiee::CodeGenVisitor::generateArithmetic(Expr *expr, std::map<Expr *, llvm::Value *> &values, llvm::Value **overflow) {
+    auto value = values.find(expr);
+    if (value != values.end()) {
+        return value->second;
+    }
+
+    BinaryExpr *binary_expr = static_cast<BinaryExpr *>(expr);
+    llvm::Value *lhs = generateArithmetic(binary_expr->leftOperand, values, overflow);
+    llvm::Value *rhs = generateArithmetic(binary_expr->rightOperand, values, overflow);
+    llvm::Type *int64_type = llvm::Type::getInt64Ty(context);
+
+    llvm::Intrinsic::ID intrinsic;
+    const char *fallback;
+    switch (binary_expr->op) {
+    case '+':
+        intrinsic = llvm::Intrinsic::sadd_with_overflow;
+        fallback = "_bignum_add";
+        break;
+    case '-':
+        intrinsic = llvm::Intrinsic::ssub_with_overflow;
+        fallback = "_bignum_sub";
+        break;
+    default:
+        intrinsic = llvm::Intrinsic::smul_with_overflow;
+        fallback = "_bignum_mul";
+        break;
+    }
+
+    if (!overflow) {
+        return builder.CreateCall(bignumFunction(fallback, int64_type, { int64_type, int64_type }), { lhs, rhs });
+    }
+
+    llvm::Function *with_overflow = llvm::Intrinsic::getDeclaration(module.get(), intrinsic, { int64_type });
+    llvm::Value *checked = builder.CreateCall(with_overflow, { lhs, rhs });
+    *overflow = builder.CreateOr(*overflow, builder.CreateExtractValue(checked, 1));
+    return builder.CreateExtractValue(checked, 0, "fast");
+}
+
+llvm::Value *Rubiee::CodeGenVisitor::generateIntegerComparison(llvm::CmpInst::Predicate predicate, llvm::Value *lhs, llvm::Value *rhs, bool fixnums) {
+    // Bignums are interned, so equal integers have equal bits
+    bool equality = predicate == llvm::CmpInst::ICMP_EQ || predicate == llvm::CmpInst::ICMP_NE;
+    if (fixnums || equality || !overflow_checks || !lhs->getType()->isIntegerTy(64)) {
+        return builder.CreateICmp(predicate, lhs, rhs, "cmp");
+    }
+
+    llvm::Type *int32_type = llvm::Type::getInt32Ty(context);
+    llvm::Function *current_function = builder.GetInsertBlock()->getParent();
+    llvm::BasicBlock *fast_block = llvm::BasicBlock::Create(context, "fixnum_cmp", current_function);
+    llvm::BasicBlock *slow_block = llvm::BasicBlock::Create(context, "bignum_cmp", current_function);
+    llvm::BasicBlock *end_block = llvm::BasicBlock::Create(context, "cmp_end", current_function);
+    builder.CreateCondBr(builder.CreateNot(builder.CreateOr(isBignum(lhs), isBignum(rhs))), fast_block, slow_block, likelyBranch());
+
+    builder.SetInsertPoint(fast_block);
+    llvm::Value *fast_value = builder.CreateICmp(predicate, lhs, rhs, "cmp");
+    builder.CreateBr(end_block);
+
+    // `_bignum_compare` orders its operands like `lhs` and `rhs`
+    builder.SetInsertPoint(slow_block);
+    llvm::Type *int64_type = llvm::Type::getInt64Ty(context);
+    llvm::Value *order = builder.CreateCall(bignumFunction("_bignum_compare", int32_type, { int64_type, int64_type }), { lhs, rhs });
+    llvm::Value *slow_value = builder.CreateICmp(predicate, order, llvm::ConstantInt::get(int32_type, 0), "cmp");
+    builder.CreateBr(end_block);
+
+    builder.SetInsertPoint(end_block);
+    llvm::PHINode *phi_node = builder.CreatePHI(builder.getInt1Ty(), 2, "cmp");
+    phi_node->addIncoming(fast_value, fast_block);
+    phi_node->addIncoming(slow_value, slow_block);
+    return phi_node;
+}
+
+llvm::Function *Rubiee::CodeGenVisitor::bignumFunction(const char *symbol, llvm::Type *return_type, std::vector<llvm::Type *> arg_types) {
+    if (llvm::Function *fn = module->getFunction(symbol)) {
+        return fn;
+    }
+
+    llvm::Function *fn = llvm::Function::Create(
+        llvm::FunctionType::get(return_type, arg_types, false),
+        llvm::Function::ExternalLinkage,
+        symbol,
+        module.get()
+    );
+    // Keeps the calls out of the way of the fast path
+    fn->addFnAttr(llvm::Attribute::Cold);
+    return fn;
+}
+
+llvm::Value *Rubiee::CodeGenVisitor::isBignum(llvm::Value *value) {
+    return builder.CreateICmpSLT(value, llvm::ConstantInt::get(value->getType(), RUBIEE_FIXNUM_MIN), "is_bignum");
+}
+
+bool Rubiee::CodeGenVisitor::isFixnum(Expr *expr) {
+    // 32-bit integers are sign extended, and constants are never that large
+    return typeOf(expr) == INT32 || dynamic_cast<IntConst *>(expr) != nullptr;
+}
+
+llvm::MDNode *Rubiee::CodeGenVisitor::likelyBranch() {
+    return llvm::MDBuilder(context).createBranchWeights(1 << 20, 1);
+}
+
 void Rubiee::CodeGenVisitor::visit(ComparisonExpr &comparison_expr) {
     llvm::Value *lhs, *rhs;
 
@@ -120,17 +694,44 @@ void Rubiee::CodeGenVisitor::visit(ComparisonExpr &comparison_expr) {
         return;
     }
 
+    // Operands are compared in the larger of their types
+    NumericType type = std::max(typeOf(comparison_expr.leftOperand), typeOf(comparison_expr.rightOperand));
+    lhs = convert(lhs, type);
+    rhs = convert(rhs, type);
+
+    if (type == DOUBLE) {
+        if (comparison_expr.op == ">") {
+            generated_value = builder.CreateFCmpOGT(lhs, rhs, ">");
+        } else if (comparison_expr.op == "<") {
+            generated_value = builder.CreateFCmpOLT(lhs, rhs, "<");
+        } else if (comparison_expr.op == "==") {
+            generated_value = builder.CreateFCmpOEQ(lhs, rhs, "==");
+        } else if (comparison_expr.op == ">=") {
+            generated_value = builder.CreateFCmpOGE(lhs, rhs, ">=");
+        } else if (comparison_expr.op == "<=") {
+            generated_value = builder.CreateFCmpOLE(lhs, rhs, "<=");
+        }
+        return;
+    }
+
+    llvm::CmpInst::Predicate predicate;
     if (comparison_expr.op == ">") {
-        generated_value = builder.CreateICmpSGT(lhs, rhs, ">");
+        predicate = llvm::CmpInst::ICMP_SGT;
     } else if (comparison_expr.op == "<") {
-        generated_value = builder.CreateICmpSLT(lhs, rhs, "<");
+        predicate = llvm::CmpInst::ICMP_SLT;
     } else if (comparison_expr.op == "==") {
-        generated_value = builder.CreateICmpEQ(lhs, rhs, "==");
+        predicate = llvm::CmpInst::ICMP_EQ;
     } else if (comparison_expr.op == ">=") {
-        generated_value = builder.CreateICmpSGE(lhs, rhs, ">=");
+        predicate = llvm::CmpInst::ICMP_SGE;
     } else if (comparison_expr.op == "<=") {
-        generated_value = builder.CreateICmpSLE(lhs, rhs, "<=");
+        predicate = llvm::CmpInst::ICMP_SLE;
+    } else {
+        generated_value = nullptr;
+        return;
     }
+    generated_value = generateIntegerComparison(
+        predicate, lhs, rhs, isFixnum(comparison_expr.leftOperand) && isFixnum(comparison_expr.rightOperand)
+    );
 }
 
 void Rubiee::CodeGenVisitor::visit(IfExpr &if_expr) {
@@ -142,11 +743,8 @@ void Rubiee::CodeGenVisitor::visit(IfExpr &if_expr) {
         return;
     }
 
-    cond = builder.CreateICmpNE(
-        cond,
-        llvm::ConstantInt::getFalse(context),
-        "ifcond"
-    );
+    cond = toCondition(cond);
+    NumericType type = typeOf(&if_expr);
 
     llvm::Function *current_function = builder.GetInsertBlock()->getParent();
 
@@ -160,6 +758,7 @@ void Rubiee::CodeGenVisitor::visit(IfExpr &if_expr) {
     builder.SetInsertPoint(then_block);
 
     for (auto expr = if_expr.then_exprs.begin(); expr != if_expr.then_exprs.end(); ++expr) {
+        markLine((*expr)->line);
         (*expr)->accept(*this);
     }
     llvm::Value *then_value = generated_value;
@@ -176,6 +775,7 @@ void Rubiee::CodeGenVisitor::visit(IfExpr &if_expr) {
         generated_value = nullptr;
         return;
     }
+    then_value = convert(then_value, type);
 
     builder.CreateBr(end_block);
 
@@ -188,6 +788,7 @@ void Rubiee::CodeGenVisitor::visit(IfExpr &if_expr) {
     builder.SetInsertPoint(else_block);
 
     for (auto expr = if_expr.else_exprs.begin(); expr != if_expr.else_exprs.end(); ++expr) {
+        markLine((*expr)->line);
         (*expr)->accept(*this);
     }
     llvm::Value *else_value = generated_value;
@@ -204,6 +805,7 @@ void Rubiee::CodeGenVisitor::visit(IfExpr &if_expr) {
         generated_value = nullptr;
         return;
     }
+    else_value = convert(else_value, type);
 
     builder.CreateBr(end_block);
 
@@ -215,15 +817,137 @@ void Rubiee::CodeGenVisitor::visit(IfExpr &if_expr) {
     current_function->getBasicBlockList().push_back(end_block);
     builder.SetInsertPoint(end_block);
 
-    llvm::PHINode *phi_node = builder.CreatePHI(llvm::Type::getInt32Ty(context), 2, "if_val");
+    llvm::PHINode *phi_node = builder.CreatePHI(llvmType(type), 2, "if_val");
     phi_node->addIncoming(then_value, then_block);
     phi_node->addIncoming(else_value, else_block);
 
     generated_value = phi_node;
 }
 
+llvm::Value *Rubiee::CodeGenVisitor::generateExprs(std::vector<Expr*> &exprs) {
+    if (exprs.size() == 0) {
+        return llvm::ConstantInt::get(
+            context, 
+            llvm::APInt(32, 0, true)
+        );
+    }
+
+    for (auto expr = exprs.begin(); expr != exprs.end(); ++expr) {
+        markLine((*expr)->line);
+        (*expr)->accept(*this);
+    }
+    return generated_value;
+}
+
+void Rubiee::CodeGenVisitor::visit(CaseExpr &case_expr) {
+    case_expr.subject->accept(*this);
+    llvm::Value *subject = generated_value;
+
+    if (!subject) {
+        generated_value = nullptr;
+        return;
+    }
+
+    llvm::Function *current_function = builder.GetInsertBlock()->getParent();
+
+    std::vector<llvm::BasicBlock *> when_blocks;
+    for (unsigned i = 0; i < case_expr.whens.size(); i++) {
+        when_blocks.push_back(llvm::BasicBlock::Create(context, "when"));
+    }
+    llvm::BasicBlock *else_block = llvm::BasicBlock::Create(context, "case_else");
+    llvm::BasicBlock *end_block = llvm::BasicBlock::Create(context, "case_end");
+
+    // The subject and the values are compared in the largest of their types
+    NumericType compare_type = typeOf(case_expr.subject);
+    bool all_constant = true;
+    unsigned value_num = 0;
+    for (auto when = case_expr.whens.begin(); when != case_expr.whens.end(); ++when) {
+        for (auto value = when->values.begin(); value != when->values.end(); ++value) {
+            all_constant = all_constant && dynamic_cast<IntConst *>(*value);
+            compare_type = std::max(compare_type, typeOf(*value));
+            value_num++;
+        }
+    }
+    subject = convert(subject, compare_type);
+
+    if (all_constant && compare_type != DOUBLE) {
+        // The backend lowers a `switch` to a jump table when its cases are
+        // dense, and to a balanced tree of compares when they are sparse
+        llvm::SwitchInst *dispatch = builder.CreateSwitch(subject, else_block, value_num);
+
+        // Like Ruby, the first `when` matching a value wins
+        std::set<long long> seen;
+        for (unsigned i = 0; i < case_expr.whens.size(); i++) {
+            std::vector<Expr*> &values = case_expr.whens[i].values;
+            for (auto value = values.begin(); value != values.end(); ++value) {
+                long long val = static_cast<IntConst *>(*value)->val;
+                if (seen.insert(val).second) {
+                    dispatch->addCase(
+                        llvm::cast<llvm::ConstantInt>(llvm::ConstantInt::getSigned(llvmType(compare_type), val)),
+                        when_blocks[i]
+                    );
+                }
+            }
+        }
+    } else {
+        // Values are arbitrary expressions, evaluate and compare them in order
+        for (unsigned i = 0; i < case_expr.whens.size(); i++) {
+            std::vector<Expr*> &values = case_expr.whens[i].values;
+            for (auto value = values.begin(); value != values.end(); ++value) {
+                (*value)->accept(*this);
+                if (!generated_value) {
+                    return;
+                }
+
+                llvm::Value *value_of_when = convert(generated_value, compare_type);
+                llvm::Value *matched = compare_type == DOUBLE ?
+                                       builder.CreateFCmpOEQ(subject, value_of_when, "when_cond") :
+                                       builder.CreateICmpEQ(subject, value_of_when, "when_cond");
+                llvm::BasicBlock *next_block = llvm::BasicBlock::Create(context, "when_next", current_function);
+                builder.CreateCondBr(matched, when_blocks[i], next_block);
+                builder.SetInsertPoint(next_block);
+            }
+        }
+        builder.CreateBr(else_block);
+    }
+
+    // Generate code for every `when` body and the `else` body, they all
+    // continue at `end_block`
+    NumericType type = typeOf(&case_expr);
+    std::vector<std::pair<llvm::Value *, llvm::BasicBlock *>> incoming;
+    for (unsigned i = 0; i <= case_expr.whens.size(); i++) {
+        bool is_else = i == case_expr.whens.size();
+        llvm::BasicBlock *block = is_else ? else_block : when_blocks[i];
+
+        current_function->getBasicBlockList().push_back(block);
+        builder.SetInsertPoint(block);
+
+        llvm::Value *value = generateExprs(is_else ? case_expr.else_exprs : case_expr.whens[i].body_exprs);
+        if (!value) {
+            generated_value = nullptr;
+            return;
+        }
+        value = convert(value, type);
+        builder.CreateBr(end_block);
+
+        // Nested control flow can change the current block
+        incoming.push_back(std::make_pair(value, builder.GetInsertBlock()));
+    }
+
+    current_function->getBasicBlockList().push_back(end_block);
+    builder.SetInsertPoint(end_block);
+
+    llvm::PHINode *phi_node = builder.CreatePHI(llvmType(type), incoming.size(), "case_val");
+    for (auto value = incoming.begin(); value != incoming.end(); ++value) {
+        phi_node->addIncoming(value->first, value->second);
+    }
+
+    generated_value = phi_node;
+}
+
 void Rubiee::CodeGenVisitor::visit(ForLoopExpr &for_loop_expr) {
     for_loop_expr.start_expr->accept(*this);
+    llvm::Value *outer_depth = pushFrame("for@" + std::to_string(for_loop_expr.line), for_loop_expr.line, for_loop_expr.end_line);
 
     llvm::Function *current_function = builder.GetInsertBlock()->getParent();
     llvm::BasicBlock *before_loop_body_block = llvm::BasicBlock::Create(context, "before_loop_body", current_function);
@@ -233,6 +957,9 @@ void Rubiee::CodeGenVisitor::visit(ForLoopExpr &for_loop_expr) {
     builder.CreateBr(before_loop_body_block);
     builder.SetInsertPoint(before_loop_body_block);
 
+    // The condition and the step are attributed to the `for` line
+    markLine(for_loop_expr.line);
+
     for_loop_expr.continue_condition->accept(*this);
     llvm::Value *cond = generated_value;
 
@@ -241,19 +968,17 @@ void Rubiee::CodeGenVisitor::visit(ForLoopExpr &for_loop_expr) {
         return;
     }
 
-    cond = builder.CreateICmpEQ(
-        cond,
-        llvm::ConstantInt::getTrue(context),
-        "loop_cond"
-    );
+    cond = toCondition(cond);
 
     builder.CreateCondBr(cond, loop_body_block, after_loop_body_block);
 
     builder.SetInsertPoint(loop_body_block);
     for (auto expr = for_loop_expr.body_exprs.begin(); expr != for_loop_expr.body_exprs.end(); ++expr) {
+        markLine((*expr)->line);
         (*expr)->accept(*this);
     }
 
+    markLine(for_loop_expr.line);
     for_loop_expr.step_expr->accept(*this);
 
     builder.CreateBr(before_loop_body_block);
@@ -261,10 +986,159 @@ void Rubiee::CodeGenVisitor::visit(ForLoopExpr &for_loop_expr) {
     current_function->getBasicBlockList().push_back(after_loop_body_block);
 
     builder.SetInsertPoint(after_loop_body_block);    
+    popFrame(outer_depth);
+    markLine(for_loop_expr.line);
+
+    // A loop is `0`, see `TypeInference`
+    generated_value = llvm::ConstantInt::get(
+        context, 
+        llvm::APInt(32, 0, true)
+    );
+}
+
+void Rubiee::CodeGenVisitor::visit(RangeLoopExpr &range_loop_expr) {
+    range_loop_expr.first->accept(*this);
+    llvm::Value *first = generated_value;
+    range_loop_expr.last->accept(*this);
+    llvm::Value *last = generated_value;
+    if (!first || !last) {
+        generated_value = nullptr;
+        return;
+    }
+
+    NumericType type = counterType(typeOf(range_loop_expr.first), typeOf(range_loop_expr.last));
+    first = convert(first, type);
+    last = convert(last, type);
+    Block &block = *range_loop_expr.block;
+
+    // The block is inlined into a counted loop, with the counter in a register
+    // of its own so that assigning the parameter does not change the count
+    llvm::Function *current_function = builder.GetInsertBlock()->getParent();
+    llvm::BasicBlock *after_block = llvm::BasicBlock::Create(context, "after_range");
+
+    // The condition and the step are attributed to the first line
+    llvm::Value *outer_depth = pushFrame(
+        "each@" + std::to_string(range_loop_expr.line), range_loop_expr.line, block.end_line
+    );
+    markLine(range_loop_expr.line);
+
+    // The counter cannot step through bignums, whose handles do not follow the
+    // order of their values
+    if (type == INT64 && overflow_checks &&
+        !(isFixnum(range_loop_expr.first) && isFixnum(range_loop_expr.last))) {
+        llvm::BasicBlock *error_block = llvm::BasicBlock::Create(context, "range_bignum", current_function);
+        llvm::BasicBlock *fixnum_block = llvm::BasicBlock::Create(context, "range_fixnums", current_function);
+        builder.CreateCondBr(
+            builder.CreateNot(builder.CreateOr(isBignum(first), isBignum(last))), fixnum_block, error_block, likelyBranch()
+        );
+
+        builder.SetInsertPoint(error_block);
+        builder.CreateCall(bignumFunction("_bignum_range_error", builder.getVoidTy(), {}), {});
+        builder.CreateBr(after_block);
+
+        builder.SetInsertPoint(fixnum_block);
+    }
+
+    // The bounds are compared once, then the loop exits after the body once
+    // the counter reaches `last`. It never steps past `last`, so it cannot
+    // wrap even if `last` is the largest integer.
+    llvm::Value *enter = range_loop_expr.exclusive ?
+        builder.CreateICmpSLT(first, last, "range_enter") :
+        builder.CreateICmpSLE(first, last, "range_enter");
+    llvm::BasicBlock *preheader_block = builder.GetInsertBlock();
+    llvm::BasicBlock *body_block = llvm::BasicBlock::Create(context, "range_body", current_function);
+    builder.CreateCondBr(enter, body_block, after_block);
+
+    builder.SetInsertPoint(body_block);
+    llvm::PHINode *counter = builder.CreatePHI(llvmType(type), 2, "counter");
+    counter->addIncoming(first, preheader_block);
+    std::vector<llvm::Value *> values(1, counter);
+    bindBlockParams(block, values);
+    generateExprs(block.body_exprs);
+
+    markLine(range_loop_expr.line);
+    llvm::Value *next = builder.CreateNSWAdd(counter, llvm::ConstantInt::get(llvmType(type), 1), "next");
+    llvm::Value *cond = range_loop_expr.exclusive ?
+        builder.CreateICmpSLT(next, last, "range_cond") :
+        builder.CreateICmpNE(counter, last, "range_cond");
+    counter->addIncoming(next, builder.GetInsertBlock());
+    builder.CreateCondBr(cond, body_block, after_block);
+
+    current_function->getBasicBlockList().push_back(after_block);
+    builder.SetInsertPoint(after_block);
+    popFrame(outer_depth);
+
+    // A loop is `0`, see `TypeInference`
+    generated_value = llvm::ConstantInt::get(
+        context, 
+        llvm::APInt(32, 0, true)
+    );
+}
+
+void Rubiee::CodeGenVisitor::visit(YieldExpr &yield_expr) {
+    std::vector<llvm::Value *> values;
+    for (auto arg = yield_expr.args.begin(); arg != yield_expr.args.end(); ++arg) {
+        (*arg)->accept(*this);
+        if (!generated_value) {
+            return;
+        }
+        values.push_back(generated_value);
+    }
+
+    const TypeInference::InlineFrame *frame = inline_frame;
+    if (!frame) {
+        fprintf(stderr, "No block given to `yield` to.\n");
+        generated_value = nullptr;
+        return;
+    }
+
+    // The block is generated in place, in the scope of its caller
+    std::string callee_scope = scope;
+    scope = frame->caller_scope;
+    inline_frame = frame->caller;
+
+    bindBlockParams(*frame->block, values);
+    llvm::Value *value = generateExprs(frame->block->body_exprs);
+
+    scope = callee_scope;
+    inline_frame = frame;
+    generated_value = value ? convert(value, typeOf(&yield_expr)) : nullptr;
+}
+
+void Rubiee::CodeGenVisitor::bindBlockParams(Block &block, std::vector<llvm::Value *> &values) {
+    for (unsigned i = 0; i < block.params.size(); i++) {
+        std::string name = scope + block.params[i];
+        llvm::Value *value = i < values.size() ? values[i] : llvm::ConstantInt::get(llvm::Type::getInt32Ty(context), 0);
+        builder.CreateStore(convert(value, variableType(name)), variableFor(name));
+    }
+}
+
+llvm::AllocaInst *Rubiee::CodeGenVisitor::variableFor(const std::string &name) {
+    auto variable = variables.find(name);
+    if (variable != variables.end() && variable->second) {
+        return variable->second;
+    }
+
+    // Allocas in the entry block are promoted to registers by `optimizeModule`
+    llvm::Function *current_function = builder.GetInsertBlock()->getParent();
+    llvm::IRBuilder<> variable_builder(
+        &current_function->getEntryBlock(),
+        current_function->getEntryBlock().begin()
+    );
+    return variables[name] = variable_builder.CreateAlloca(
+        llvmType(variableType(name)),
+        0,
+        name.c_str()
+    );
+}
+
+Rubiee::NumericType Rubiee::CodeGenVisitor::variableType(const std::string &name) {
+    auto type = current_types->variables.find(name);
+    return type == current_types->variables.end() ? INT32 : type->second;
 }
 
 void Rubiee::CodeGenVisitor::visit(Variable &var) {
-    llvm::Value *variable = variables[var.name];
+    llvm::Value *variable = variables[scope + var.name];
     if (!variable) {
         fprintf(stderr, "Variable `%s` is undefined.\n", var.name.c_str());
         generated_value = nullptr;
@@ -275,106 +1149,721 @@ void Rubiee::CodeGenVisitor::visit(Variable &var) {
 }
 
 void Rubiee::CodeGenVisitor::visit(VariableAssignment &var_assignment) {
-    // variable is not defined yet
-    if (variables.find(var_assignment.var->name) == variables.end()) {
-        llvm::Function *current_function = builder.GetInsertBlock()->getParent();
-        llvm::IRBuilder<> variable_builder(
-            &current_function->getEntryBlock(),
-            current_function->getEntryBlock().begin()
-        );
-        variables[var_assignment.var->name] = variable_builder.CreateAlloca(
-            llvm::Type::getInt32Ty(context),
-            0,
-            var_assignment.var->name.c_str()
-        );
-    }
-
-    llvm::Value *variable_pointer = variables[var_assignment.var->name];
+    llvm::AllocaInst *variable_pointer = variableFor(scope + var_assignment.var->name);
 
     var_assignment.expr->accept(*this);
     llvm::Value *init_value = generated_value;
+    if (!init_value) {
+        return;
+    }
 
-    builder.CreateStore(init_value, variable_pointer);
+    // Variables hold the largest type assigned to them
+    builder.CreateStore(convert(init_value, typeOf(var_assignment.var)), variable_pointer);
     var_assignment.var->accept(*this);
 }
 
 void Rubiee::CodeGenVisitor::visit(FunctionCall &function_call) {
-    llvm::Function *fn;
-
-    // if is a standard library function
-    if (stdlib_functions.find(function_call.callee) != stdlib_functions.end()) {
-        fn = stdlib_functions[function_call.callee];
-    }
-
     std::vector<llvm::Value *> args_value;
+    std::vector<NumericType> arg_types;
 
     for (unsigned i = 0; i < function_call.args.size(); i++) {
         function_call.args[i]->accept(*this);
+        if (!generated_value) {
+            return;
+        }
         args_value.push_back(generated_value);
+        arg_types.push_back(typeOf(function_call.args[i]));
     }
 
-    // Pass the number of variable arguments
-    if (fn->isVarArg()) {
-        unsigned var_arg_num = function_call.args.size() == 0 ? 
-                               fn->arg_size() :
-                               function_call.args.size() - ( fn->arg_size() - 1 );
+    // if is a standard library function
+    if (stdlib_functions.find(function_call.callee) != stdlib_functions.end()) {
+        llvm::Function *fn = stdlib_functions[function_call.callee];
+        if (function_call.block) {
+            fprintf(stderr, "Function `%s` does not take a block.\n", function_call.callee.c_str());
+            generated_value = nullptr;
+            return;
+        }
+        if (fn->isVarArg()) {
+            generatePuts(args_value, arg_types);
+            return;
+        }
+        if (fn->arg_size() != args_value.size()) {
+            fprintf(stderr, "Function `%s` takes %u arguments.\n", function_call.callee.c_str(), (unsigned) fn->arg_size());
+            generated_value = nullptr;
+            return;
+        }
+
+        const Builtin *builtin = findFunction(function_call.callee);
+        for (unsigned i = 0; i < args_value.size(); i++) {
+            args_value[i] = convert(args_value[i], builtin->arg_types[i]);
+        }
+
+        // Lookups are the hot path of counting and grouping
+        if (function_call.callee == "hash_get" || function_call.callee == "hash_has") {
+            generated_value = generateHashLookup(fn, args_value[0], args_value[1], function_call.callee == "hash_has");
+            return;
+        }
+        generated_value = builder.CreateCall(fn, args_value);
+        return;
+    }
 
-        args_value.insert(
-            args_value.begin() + (fn->arg_size() - 1),
-            llvm::ConstantInt::get(
-                context,
-                llvm::APInt(32, var_arg_num, true)
-            )
-        );
+    // user functions are compiled once per signature, and all declared up
+    // front by `declareFunctions`. Functions of required files are called
+    // through the specialization they export for the arguments.
+    llvm::Function *fn = nullptr;
+    Function *definition = type_inference.definition(function_call.callee);
+    auto imported = imported_functions.find(function_call.callee);
+    if (definition) {
+        if (definition->proto->args.size() != args_value.size()) {
+            fprintf(stderr, "Function `%s` takes %u arguments.\n", function_call.callee.c_str(), (unsigned) definition->proto->args.size());
+            generated_value = nullptr;
+            return;
+        }
+        if (function_call.block) {
+            generateInlineCall(function_call, *definition, args_value);
+            return;
+        }
+        const TypeInference::Specialization *specialization = type_inference.find(function_call.callee, arg_types);
+        fn = specialization ? module->getFunction(function_prefix + specialization->name) : nullptr;
+    } else if (imported != imported_functions.end()) {
+        if (imported->second.arg_num != args_value.size()) {
+            fprintf(stderr, "Function `%s` takes %u arguments.\n", function_call.callee.c_str(), imported->second.arg_num);
+            generated_value = nullptr;
+            return;
+        }
+        // Blocks are inlined with the function, which is compiled with its file
+        if (function_call.block) {
+            fprintf(stderr, "Function `%s` of another file cannot take a block.\n", function_call.callee.c_str());
+            generated_value = nullptr;
+            return;
+        }
+        unsigned index = TypeInference::exportedIndex(arg_types);
+        arg_types = TypeInference::exportedSignatures(imported->second.arg_num)[index];
+        fn = declareImport(imported->second.symbol, arg_types, type_inference.importOf(function_call.callee)->at(index));
+    }
+    if (!fn) {
+        fprintf(stderr, "Function `%s` is undefined.\n", function_call.callee.c_str());
+        generated_value = nullptr;
+        return;
+    }
+
+    for (unsigned i = 0; i < args_value.size(); i++) {
+        args_value[i] = convert(args_value[i], arg_types[i]);
     }
-    
     generated_value = builder.CreateCall(fn, args_value);
+
+    // The callee changed the line
+    markLine(function_call.line);
 }
 
-void Rubiee::CodeGenVisitor::visit(FunctionPrototype &function_prototype) {
-    std::vector<llvm::Type *> int_args(
-        function_prototype.args.size(), 
-        llvm::Type::getInt32Ty(context)
+llvm::Function *Rubiee::CodeGenVisitor::declareImport(const std::string &symbol, const TypeInference::Signature &arg_types, NumericType return_type) {
+    std::string name = TypeInference::specializationName(symbol, arg_types);
+    llvm::Function *fn = module->getFunction(name);
+    if (fn) {
+        return fn;
+    }
+
+    std::vector<llvm::Type *> types;
+    for (auto type = arg_types.begin(); type != arg_types.end(); ++type) {
+        types.push_back(llvmType(*type));
+    }
+    return llvm::Function::Create(
+        llvm::FunctionType::get(llvmType(return_type), types, false),
+        llvm::Function::ExternalLinkage,
+        name,
+        module.get()
     );
-    llvm::FunctionType *function_type = llvm::FunctionType::get(
-        llvm::Type::getInt32Ty(context),
-        int_args,
-        false
+}
+
+void Rubiee::CodeGenVisitor::generateInlineCall(FunctionCall &function_call, Function &definition, std::vector<llvm::Value *> &args) {
+    // A block is never a closure: the function is generated in place, and
+    // every `yield` in it generates the block in place
+    if (TypeInference::isInlined(inline_frame, &definition)) {
+        fprintf(stderr, "Function `%s` is recursive, it cannot take a block.\n", function_call.callee.c_str());
+        generated_value = nullptr;
+        return;
+    }
+
+    TypeInference::InlineFrame frame = { &definition, function_call.block, scope, inline_frame };
+    scope = TypeInference::inlineScope(scope, function_call);
+    inline_frame = &frame;
+
+    for (unsigned i = 0; i < args.size(); i++) {
+        std::string name = scope + definition.proto->args[i];
+        builder.CreateStore(convert(args[i], variableType(name)), variableFor(name));
+    }
+    llvm::Value *value = generateExprs(definition.body_exprs);
+
+    scope = frame.caller_scope;
+    inline_frame = frame.caller;
+    generated_value = value ? convert(value, typeOf(&function_call)) : nullptr;
+}
+
+llvm::Value *Rubiee::CodeGenVisitor::generateHashLookup(llvm::Function *fallback, llvm::Value *table, llvm::Value *key, bool has) {
+    llvm::Type *int8_type = llvm::Type::getInt8Ty(context);
+    llvm::Type *int16_type = llvm::Type::getInt16Ty(context);
+    llvm::Type *int32_type = llvm::Type::getInt32Ty(context);
+    llvm::Type *int64_type = llvm::Type::getInt64Ty(context);
+
+    // struct { int8_t *ctrl; long long *slots; unsigned long long group_mask; ... },
+    // the start of `HashTable`
+    llvm::StructType *table_type = llvm::StructType::get(
+        context,
+        { int8_type->getPointerTo(), int64_type->getPointerTo(), int64_type }
     );
-    generated_function = llvm::Function::Create(
-        function_type,
-        llvm::Function::ExternalLinkage,
-        function_prototype.name,
+    if (!hash_tables) {
+        hash_tables = new llvm::GlobalVariable(
+            *module,
+            table_type->getPointerTo()->getPointerTo(),
+            false,
+            llvm::GlobalValue::ExternalLinkage,
+            nullptr,
+            "_rubiee_hash_tables"
+        );
+        hash_count = new llvm::GlobalVariable(
+            *module,
+            int32_type,
+            false,
+            llvm::GlobalValue::ExternalLinkage,
+            nullptr,
+            "_rubiee_hash_count"
+        );
+    }
+
+    llvm::Function *current_function = builder.GetInsertBlock()->getParent();
+    llvm::BasicBlock *load_block = llvm::BasicBlock::Create(context, "hash_load", current_function);
+    llvm::BasicBlock *probe_block = llvm::BasicBlock::Create(context, "hash_probe", current_function);
+    llvm::BasicBlock *match_block = llvm::BasicBlock::Create(context, "hash_match", current_function);
+    llvm::BasicBlock *compare_block = llvm::BasicBlock::Create(context, "hash_compare", current_function);
+    llvm::BasicBlock *hit_block = llvm::BasicBlock::Create(context, "hash_hit", current_function);
+    llvm::BasicBlock *done_block = llvm::BasicBlock::Create(context, "hash_group_done", current_function);
+    llvm::BasicBlock *miss_block = llvm::BasicBlock::Create(context, "hash_miss", current_function);
+    llvm::BasicBlock *slow_block = llvm::BasicBlock::Create(context, "hash_slow", current_function);
+    llvm::BasicBlock *end_block = llvm::BasicBlock::Create(context, "hash_end", current_function);
+
+    // Invalid and freed handles are reported by the runtime
+    llvm::Value *valid = builder.CreateICmpULT(table, builder.CreateLoad(hash_count, "hash_count"));
+    builder.CreateCondBr(valid, load_block, slow_block);
+
+    builder.SetInsertPoint(load_block);
+    llvm::Value *tables = builder.CreateLoad(hash_tables, "hash_tables");
+    llvm::Value *table_pointer = builder.CreateLoad(
+        builder.CreateInBoundsGEP(tables, builder.CreateZExt(table, int64_type)), "hash_table"
+    );
+    builder.CreateCondBr(builder.CreateIsNull(table_pointer), slow_block, probe_block);
+
+    // Only the home group is probed inline: every slot whose control byte
+    // matches is compared, and if none holds the key, an empty slot in the
+    // group means the key is missing. Keys whose probe goes on to other
+    // groups are left to the runtime. The hash must match `hashKey` in
+    // `stdlib_hash.cpp`.
+    builder.SetInsertPoint(probe_block);
+    auto member = [&](unsigned index, const char *name) {
+        return builder.CreateLoad(
+            builder.CreateInBoundsGEP(table_pointer, { llvm::ConstantInt::get(int32_type, 0), llvm::ConstantInt::get(int32_type, index) }),
+            name
+        );
+    };
+    llvm::Value *ctrl = member(0, "ctrl");
+    llvm::Value *slots = member(1, "slots");
+    llvm::Value *group_mask = member(2, "group_mask");
+
+    llvm::Value *hash = builder.CreateMul(key, llvm::ConstantInt::get(int64_type, 0x9E3779B97F4A7C15ULL), "hash");
+    hash = builder.CreateXor(hash, builder.CreateLShr(hash, llvm::ConstantInt::get(int64_type, 32)), "hash");
+    llvm::Value *control = builder.CreateTrunc(builder.CreateAnd(hash, llvm::ConstantInt::get(int64_type, 0x7F)), int8_type, "control");
+    llvm::Value *group = builder.CreateAnd(builder.CreateLShr(hash, llvm::ConstantInt::get(int64_type, 7)), group_mask, "group");
+    llvm::Value *first_slot = builder.CreateMul(group, llvm::ConstantInt::get(int64_type, HASH_GROUP_SIZE), "first_slot");
+
+    // Compare the 16 control bytes of the group at once, the backend turns
+    // this into `pcmpeqb` and `pmovmskb`
+    llvm::Type *group_type = llvm::VectorType::get(int8_type, HASH_GROUP_SIZE);
+    llvm::Value *group_pointer = builder.CreateBitCast(
+        builder.CreateInBoundsGEP(ctrl, first_slot), group_type->getPointerTo()
+    );
+    llvm::Value *controls = builder.CreateAlignedLoad(group_pointer, HASH_GROUP_SIZE, "controls");
+    auto matchGroup = [&](llvm::Value *byte, const char *name) {
+        return builder.CreateBitCast(
+            builder.CreateICmpEQ(controls, builder.CreateVectorSplat(HASH_GROUP_SIZE, byte)),
+            int16_type,
+            name
+        );
+    };
+    llvm::Value *matches = matchGroup(control, "matches");
+    llvm::Value *empty = matchGroup(llvm::ConstantInt::get(int8_type, HASH_EMPTY, true), "empty");
+    builder.CreateBr(match_block);
+
+    // Visit the matching slots from the lowest one, clearing each bit in turn
+    builder.SetInsertPoint(match_block);
+    llvm::PHINode *remaining = builder.CreatePHI(int16_type, 2, "remaining");
+    remaining->addIncoming(matches, probe_block);
+    llvm::Value *zero = llvm::ConstantInt::get(int16_type, 0);
+    builder.CreateCondBr(builder.CreateICmpNE(remaining, zero), compare_block, done_block);
+
+    builder.SetInsertPoint(compare_block);
+    llvm::Function *cttz = llvm::Intrinsic::getDeclaration(module.get(), llvm::Intrinsic::cttz, { int16_type });
+    llvm::Value *index = builder.CreateCall(cttz, { remaining, llvm::ConstantInt::getTrue(context) });
+    llvm::Value *slot = builder.CreateAdd(first_slot, builder.CreateZExt(index, int64_type), "slot");
+    llvm::Value *key_index = builder.CreateShl(slot, llvm::ConstantInt::get(int64_type, 1));
+    llvm::Value *slot_key = builder.CreateLoad(builder.CreateInBoundsGEP(slots, key_index), "slot_key");
+    remaining->addIncoming(
+        builder.CreateAnd(remaining, builder.CreateSub(remaining, llvm::ConstantInt::get(int16_type, 1))),
+        compare_block
+    );
+    builder.CreateCondBr(builder.CreateICmpEQ(slot_key, key), hit_block, match_block);
+
+    builder.SetInsertPoint(hit_block);
+    llvm::Value *hit_value;
+    if (has) {
+        hit_value = llvm::ConstantInt::get(int32_type, 1);
+    } else {
+        hit_value = builder.CreateLoad(builder.CreateInBoundsGEP(slots, builder.CreateAdd(key_index, llvm::ConstantInt::get(int64_type, 1))), "slot_value");
+    }
+    builder.CreateBr(end_block);
+
+    // A key is never placed past a group with an empty slot
+    builder.SetInsertPoint(done_block);
+    builder.CreateCondBr(builder.CreateICmpNE(empty, zero), miss_block, slow_block);
+
+    builder.SetInsertPoint(miss_block);
+    llvm::Value *miss_value = llvm::ConstantInt::get(fallback->getReturnType(), 0);
+    builder.CreateBr(end_block);
+
+    builder.SetInsertPoint(slow_block);
+    llvm::Value *slow_value = builder.CreateCall(fallback, { table, key });
+    builder.CreateBr(end_block);
+
+    builder.SetInsertPoint(end_block);
+    llvm::PHINode *phi_node = builder.CreatePHI(fallback->getReturnType(), 3, has ? "has" : "value");
+    phi_node->addIncoming(hit_value, hit_block);
+    phi_node->addIncoming(miss_value, miss_block);
+    phi_node->addIncoming(slow_value, slow_block);
+    return phi_node;
+}
+
+void Rubiee::CodeGenVisitor::generatePuts(std::vector<llvm::Value *> &args, std::vector<NumericType> &arg_types) {
+    // void _puts(int num, ...), every argument is passed as its type and then
+    // its value, see `runtime.h`
+    std::vector<llvm::Value *> puts_args;
+    puts_args.push_back(llvm::ConstantInt::get(context, llvm::APInt(32, args.size(), true)));
+
+    for (unsigned i = 0; i < args.size(); i++) {
+        bool is_double = arg_types[i] == DOUBLE;
+        PutsArgType type = is_double ? PUTS_DOUBLE : overflow_checks ? PUTS_INT : PUTS_FIXNUM;
+        puts_args.push_back(llvm::ConstantInt::get(context, llvm::APInt(32, type, true)));
+        puts_args.push_back(convert(args[i], is_double ? DOUBLE : INT64));
+    }
+    builder.CreateCall(stdlib_functions["puts"], puts_args);
+
+    // Like a builtin, `puts` is an `int`, see `TypeInference`
+    generated_value = llvm::ConstantInt::get(
+        context, 
+        llvm::APInt(32, 0, true)
+    );
+}
+
+void Rubiee::CodeGenVisitor::visit(Require &require) {
+    if (require.symbol.empty()) {
+        fprintf(stderr, "Required file `%s` is not loaded.\n", require.path.c_str());
+        generated_value = nullptr;
+        return;
+    }
+
+    // int entry(), defined in the module of the required file
+    llvm::Function *entry = module->getFunction(require.symbol);
+    if (!entry) {
+        entry = llvm::Function::Create(
+            llvm::FunctionType::get(
+                llvm::Type::getInt32Ty(context),
+                std::vector<llvm::Type *>(0),
+                false
+            ),
+            llvm::Function::ExternalLinkage,
+            require.symbol,
+            module.get()
+        );
+    }
+
+    generated_value = builder.CreateCall(entry, std::vector<llvm::Value *>());
+    markLine(require.line);
+}
+
+// Prototypes are declared once per specialization by `declareFunctions`
+void Rubiee::CodeGenVisitor::visit(FunctionPrototype &function_prototype) {}
+
+llvm::Function *Rubiee::CodeGenVisitor::declareSpecialization(const TypeInference::Specialization &specialization) {
+    std::vector<llvm::Type *> arg_types;
+    for (auto type = specialization.arg_types.begin(); type != specialization.arg_types.end(); ++type) {
+        arg_types.push_back(llvmType(*type));
+    }
+
+    // Only the specializations a required file exports are seen by other
+    // modules, see `TypeInference::exportedSignatures`
+    std::vector<TypeInference::Signature> exported = TypeInference::exportedSignatures(specialization.arg_types.size());
+    bool is_exported = !function_prefix.empty() &&
+                       std::find(exported.begin(), exported.end(), specialization.arg_types) != exported.end();
+    return llvm::Function::Create(
+        llvm::FunctionType::get(
+            llvmType(specialization.return_type),
+            arg_types,
+            false
+        ),
+        is_exported ? llvm::Function::ExternalLinkage : llvm::Function::InternalLinkage,
+        function_prefix + specialization.name,
         module.get()
     );
 }
 
 void Rubiee::CodeGenVisitor::visit(TopLevelExpr &top_level_expr) {
     builder.SetInsertPoint( &(main_function->back()) );
+    markLine(top_level_expr.line);
     top_level_expr.expr->accept(*this);
 }
 
 void Rubiee::CodeGenVisitor::visit(Function &function) {
-    llvm::Function *fn;
-    (function.proto)->accept(*this);
-
-    fn = generated_function;
-    if (!fn) {
+    if (!defined_functions.insert(function.proto->name).second) {
+        fprintf(stderr, "Function `%s` is already defined.\n", function.proto->name.c_str());
         generated_function = nullptr;
         return;
     }
 
-    llvm::BasicBlock *basic_block = llvm::BasicBlock::Create(context, "entry", fn);
+    // Functions which are never called have no specialization
+    std::vector<const TypeInference::Specialization*> specializations = type_inference.specializationsOf(function.proto->name);
+    for (auto specialization = specializations.begin(); specialization != specializations.end(); ++specialization) {
+        generateSpecialization(function, **specialization);
+    }
+}
+
+void Rubiee::CodeGenVisitor::generateSpecialization(Function &function, const TypeInference::Specialization &specialization) {
+    llvm::Function *fn = module->getFunction(function_prefix + specialization.name);
+    generated_function = fn;
+
+    // The body of a memoized function goes to a function of its own, `fn`
+    // becomes the result cache in front of it
+    bool memoized = memoized_functions.count(function.proto->name) > 0;
+    llvm::Function *body_fn = fn;
+    if (memoized) {
+        body_fn = llvm::Function::Create(
+            fn->getFunctionType(),
+            llvm::Function::InternalLinkage,
+            fn->getName().str() + ".body",
+            module.get()
+        );
+    }
+
+    llvm::BasicBlock *basic_block = llvm::BasicBlock::Create(context, "entry", body_fn);
     builder.SetInsertPoint(basic_block);
 
-    function.body->accept(*this);
-    llvm::Value *return_val = generated_value;
+    // Functions only see their own arguments and variables
+    std::map<std::string, llvm::AllocaInst *> outer_variables;
+    outer_variables.swap(variables);
+    const TypeInference::Specialization *outer_types = current_types;
+    current_types = &specialization;
+
+    unsigned i = 0;
+    for (auto arg = body_fn->arg_begin(); arg != body_fn->arg_end(); ++arg, ++i) {
+        const std::string &arg_name = function.proto->args[i];
+        // Arguments can be assigned a larger type in the body
+        NumericType type = specialization.variables.find(arg_name)->second;
+        arg->setName(arg_name);
+        variables[arg_name] = builder.CreateAlloca(
+            llvmType(type),
+            0,
+            arg_name.c_str()
+        );
+        builder.CreateStore(convert(&*arg, type), variables[arg_name]);
+    }
+    llvm::Value *caller_depth = pushFrame(specialization.name, 0, 0);
+
+    llvm::Value *return_val = generateExprs(function.body_exprs);
+    variables.swap(outer_variables);
+    current_types = outer_types;
+
     if (return_val) {
+        return_val = convert(return_val, specialization.return_type);
+        popFrame(caller_depth);
         builder.CreateRet(return_val);
+
+        if (memoized) {
+            generateMemoCache(fn, body_fn, function_prefix + function.proto->name);
+        }
         return;
     } 
     
-    // error
-    fn->eraseFromParent();
+    // error, keep `fn` declared as calls to it may already exist
+    if (memoized) {
+        body_fn->eraseFromParent();
+    }
+    fn->deleteBody();
     generated_function = nullptr;
+}
+
+void Rubiee::CodeGenVisitor::declareFunctions(std::vector<ASTNode*> &nodes) {
+    // Other files call the functions of a required file whatever they
+    // specialize them for
+    if (!function_prefix.empty()) {
+        type_inference.exportFunctions(nodes);
+    }
+    for (auto entry = entries.begin(); entry != entries.end(); ++entry) {
+        type_inference.addEntry(entry->name, entry->arg_types);
+    }
+    type_inference.analyze(nodes);
+    current_types = &type_inference.topLevel();
+
+    for (unsigned i = 0; i < nodes.size(); i++) {
+        Function *function = dynamic_cast<Function *>(nodes[i]);
+        if (!function || type_inference.definition(function->proto->name) != function) {
+            continue;
+        }
+
+        std::vector<const TypeInference::Specialization*> specializations = type_inference.specializationsOf(function->proto->name);
+        for (auto specialization = specializations.begin(); specialization != specializations.end(); ++specialization) {
+            declareSpecialization(**specialization);
+        }
+    }
+}
+
+void Rubiee::CodeGenVisitor::importFunction(const std::string &name, const std::string &symbol, unsigned arg_num,
+                                            const std::vector<NumericType> &return_types) {
+    ImportedFunction imported = { symbol, arg_num };
+    imported_functions[name] = imported;
+    type_inference.addImport(name, return_types);
+}
+
+void Rubiee::CodeGenVisitor::addEntry(const std::string &name, NumericType return_type, const std::vector<NumericType> &arg_types) {
+    Entry entry = { name, return_type, arg_types };
+    entries.push_back(entry);
+}
+
+std::string Rubiee::CodeGenVisitor::entryName(const std::string &name) {
+    return "__rubiee_entry_" + name;
+}
+
+bool Rubiee::CodeGenVisitor::generateEntries() {
+    llvm::IRBuilderBase::InsertPointGuard guard(builder);
+
+    for (auto entry = entries.begin(); entry != entries.end(); ++entry) {
+        Function *definition = type_inference.definition(entry->name);
+        if (!definition) {
+            fprintf(stderr, "Function `%s` is undefined.\n", entry->name.c_str());
+            return false;
+        }
+        if (definition->proto->args.size() != entry->arg_types.size()) {
+            fprintf(stderr, "Function `%s` takes %u arguments.\n", entry->name.c_str(), (unsigned) definition->proto->args.size());
+            return false;
+        }
+        const TypeInference::Specialization *specialization = type_inference.find(entry->name, entry->arg_types);
+        llvm::Function *fn = module->getFunction(function_prefix + specialization->name);
+
+        // A direct call to the specialization, which LLVM can inline
+        std::vector<llvm::Type *> arg_types;
+        for (auto type = entry->arg_types.begin(); type != entry->arg_types.end(); ++type) {
+            arg_types.push_back(llvmType(*type));
+        }
+        llvm::Function *wrapper = llvm::Function::Create(
+            llvm::FunctionType::get(llvmType(entry->return_type), arg_types, false),
+            llvm::Function::ExternalLinkage,
+            entryName(entry->name),
+            module.get()
+        );
+        builder.SetInsertPoint(llvm::BasicBlock::Create(context, "entry", wrapper));
+
+        std::vector<llvm::Value *> args;
+        for (auto arg = wrapper->arg_begin(); arg != wrapper->arg_end(); ++arg) {
+            args.push_back(&*arg);
+        }
+        builder.CreateRet(convert(builder.CreateCall(fn, args), entry->return_type));
+    }
+    return true;
+}
+
+void Rubiee::CodeGenVisitor::setMemoization(std::set<std::string> functions, unsigned cache_size, bool stats) {
+    memoized_functions = std::move(functions);
+    memo_stats = stats;
+
+    // The cache is indexed by the top bits of a hash, so its size is a power of two
+    if (cache_size > MAX_MEMO_CACHE_SIZE) {
+        cache_size = MAX_MEMO_CACHE_SIZE;
+    }
+    memo_cache_bits = 4;
+    while ((1u << memo_cache_bits) < cache_size) {
+        memo_cache_bits++;
+    }
+}
+
+void Rubiee::CodeGenVisitor::setOverflowChecks(bool checks) {
+    overflow_checks = checks;
+}
+
+void Rubiee::CodeGenVisitor::generateMemoCache(llvm::Function *fn, llvm::Function *body_fn, const std::string &name) {
+    // How many slots are tried before the home slot gets replaced
+    const unsigned MAX_PROBES = 4;
+
+    llvm::Type *int32_type = llvm::Type::getInt32Ty(context);
+    llvm::Type *int64_type = llvm::Type::getInt64Ty(context);
+    unsigned cache_size = 1u << memo_cache_bits;
+
+    // struct { int used; R value; struct { A1 a1; ... } keys; } cache[cache_size],
+    // with the return and argument types of the specialization
+    std::vector<llvm::Type *> key_types(fn->getFunctionType()->param_begin(), fn->getFunctionType()->param_end());
+    llvm::StructType *entry_type = llvm::StructType::get(
+        context,
+        { int32_type, fn->getReturnType(), llvm::StructType::get(context, key_types) }
+    );
+    llvm::ArrayType *cache_type = llvm::ArrayType::get(entry_type, cache_size);
+    // Exported, so that its bignums can be forgotten with the module, see
+    // `memoCaches`
+    llvm::GlobalVariable *cache = new llvm::GlobalVariable(
+        *module,
+        cache_type,
+        false,
+        llvm::GlobalValue::ExternalLinkage,
+        llvm::ConstantAggregateZero::get(cache_type),
+        fn->getName().str() + ".cache"
+    );
+    memo_caches.push_back(cache->getName().str());
+
+    llvm::BasicBlock *entry_block = llvm::BasicBlock::Create(context, "entry", fn);
+    llvm::BasicBlock *probe_block = llvm::BasicBlock::Create(context, "probe", fn);
+    llvm::BasicBlock *compare_block = llvm::BasicBlock::Create(context, "compare_keys", fn);
+    llvm::BasicBlock *next_probe_block = llvm::BasicBlock::Create(context, "next_probe", fn);
+    llvm::BasicBlock *hit_block = llvm::BasicBlock::Create(context, "hit", fn);
+    llvm::BasicBlock *miss_block = llvm::BasicBlock::Create(context, "miss", fn);
+
+    std::vector<llvm::Value *> args;
+    for (auto arg = fn->arg_begin(); arg != fn->arg_end(); ++arg) {
+        args.push_back(&*arg);
+    }
+
+    auto constant = [&](unsigned value) {
+        return llvm::ConstantInt::get(int32_type, value);
+    };
+    auto field = [&](llvm::Value *index, unsigned member, int key) {
+        std::vector<llvm::Value *> indices = { constant(0), index, constant(member) };
+        if (key >= 0) {
+            indices.push_back(constant(key));
+        }
+        return builder.CreateInBoundsGEP(cache, indices);
+    };
+
+    // Arguments are hashed and compared by their bits, 64-bit ones in two
+    // 32-bit halves
+    auto bits = [&](llvm::Value *value) {
+        if (value->getType()->isDoubleTy()) {
+            return builder.CreateBitCast(value, int64_type);
+        }
+        return value;
+    };
+
+    // Multiplicative hash of the arguments, its top bits are the home slot
+    builder.SetInsertPoint(entry_block);
+    llvm::Value *hash = constant(0);
+    for (unsigned i = 0; i < args.size(); i++) {
+        llvm::Value *arg = bits(args[i]);
+        if (arg->getType() == int64_type) {
+            hash = builder.CreateMul(builder.CreateXor(hash, builder.CreateTrunc(arg, int32_type)), constant(0x9E3779B1u), "hash");
+            arg = builder.CreateTrunc(builder.CreateLShr(arg, llvm::ConstantInt::get(int64_type, 32)), int32_type);
+        }
+        hash = builder.CreateMul(builder.CreateXor(hash, arg), constant(0x9E3779B1u), "hash");
+    }
+    llvm::Value *home = builder.CreateLShr(hash, constant(32 - memo_cache_bits), "home");
+    builder.CreateBr(probe_block);
+
+    // Linear probing until an empty slot or the arguments are found
+    builder.SetInsertPoint(probe_block);
+    llvm::PHINode *slot = builder.CreatePHI(int32_type, 2, "slot");
+    llvm::PHINode *probe = builder.CreatePHI(int32_type, 2, "probe");
+    slot->addIncoming(home, entry_block);
+    probe->addIncoming(constant(0), entry_block);
+    llvm::Value *used = builder.CreateLoad(field(slot, 0, -1), "used");
+    builder.CreateCondBr(builder.CreateICmpNE(used, constant(0)), compare_block, miss_block);
+
+    builder.SetInsertPoint(compare_block);
+    llvm::Value *same_keys = llvm::ConstantInt::getTrue(context);
+    for (unsigned i = 0; i < args.size(); i++) {
+        llvm::Value *key = builder.CreateLoad(field(slot, 2, i), "key");
+        same_keys = builder.CreateAnd(same_keys, builder.CreateICmpEQ(bits(key), bits(args[i])));
+    }
+    builder.CreateCondBr(same_keys, hit_block, next_probe_block);
+
+    builder.SetInsertPoint(next_probe_block);
+    llvm::Value *next_probe = builder.CreateAdd(probe, constant(1), "next_probe");
+    llvm::Value *next_slot = builder.CreateAnd(builder.CreateAdd(slot, constant(1)), constant(cache_size - 1), "next_slot");
+    slot->addIncoming(next_slot, next_probe_block);
+    probe->addIncoming(next_probe, next_probe_block);
+    builder.CreateCondBr(builder.CreateICmpULT(next_probe, constant(MAX_PROBES)), probe_block, miss_block);
+
+    // Optional hit and miss counters, read back by the driver. They are
+    // shared by every specialization of the function.
+    auto count = [&](const std::string &counter) {
+        if (!memo_stats) {
+            return;
+        }
+        llvm::GlobalVariable *global = module->getNamedGlobal(memoCounterName(name, counter));
+        if (!global) {
+            global = new llvm::GlobalVariable(
+                *module,
+                int64_type,
+                false,
+                llvm::GlobalValue::ExternalLinkage,
+                llvm::ConstantInt::get(int64_type, 0),
+                memoCounterName(name, counter)
+            );
+        }
+        builder.CreateStore(
+            builder.CreateAdd(builder.CreateLoad(global), llvm::ConstantInt::get(int64_type, 1)),
+            global
+        );
+    };
+
+    builder.SetInsertPoint(hit_block);
+    count("hits");
+    builder.CreateRet(builder.CreateLoad(field(slot, 1, -1), "cached"));
+
+    // Compute the result, and store it in the empty slot found, or in the home
+    // slot if every probed slot was taken
+    builder.SetInsertPoint(miss_block);
+    llvm::PHINode *free_slot = builder.CreatePHI(int32_type, 2, "free_slot");
+    free_slot->addIncoming(slot, probe_block);
+    free_slot->addIncoming(home, next_probe_block);
+    count("misses");
+
+    llvm::Value *result = builder.CreateCall(body_fn, args, "result");
+    builder.CreateStore(constant(1), field(free_slot, 0, -1));
+    builder.CreateStore(result, field(free_slot, 1, -1));
+    for (unsigned i = 0; i < args.size(); i++) {
+        builder.CreateStore(args[i], field(free_slot, 2, i));
+    }
+
+    // Bignums in the cache must outlive the calls which made them
+    llvm::Value *stores_bignum = llvm::ConstantInt::getFalse(context);
+    if (overflow_checks) {
+        std::vector<llvm::Value *> stored = args;
+        stored.push_back(result);
+        for (auto value = stored.begin(); value != stored.end(); ++value) {
+            if ((*value)->getType() == int64_type) {
+                stores_bignum = builder.CreateOr(stores_bignum, isBignum(*value));
+            }
+        }
+    }
+    if (!llvm::isa<llvm::Constant>(stores_bignum)) {
+        llvm::BasicBlock *keep_block = llvm::BasicBlock::Create(context, "keep_bignums", fn);
+        llvm::BasicBlock *return_block = llvm::BasicBlock::Create(context, "return", fn);
+        builder.CreateCondBr(stores_bignum, keep_block, return_block);
+
+        builder.SetInsertPoint(keep_block);
+        llvm::Type *pointer_type = llvm::Type::getInt8PtrTy(context);
+        llvm::Value *size = llvm::ConstantInt::get(int64_type, module->getDataLayout().getTypeAllocSize(cache_type));
+        builder.CreateCall(
+            bignumFunction("_bignum_keep", llvm::Type::getVoidTy(context), { pointer_type, int64_type }),
+            { builder.CreateBitCast(cache, pointer_type), size }
+        );
+        builder.CreateBr(return_block);
+
+        builder.SetInsertPoint(return_block);
+    }
+    builder.CreateRet(result);
+}
+
+std::string Rubiee::CodeGenVisitor::memoCounterName(const std::string &function, const std::string &counter) {
+    return "__rubiee_memo_" + counter + "_" + function;
 }
\ No newline at end of file
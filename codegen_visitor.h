@@ -1,56 +1,119 @@
 #ifndef __CODE_GEN_VISITOR_H__
 #define __CODE_GEN_VISITOR_H__ 1
 
+#include <map>
 #include <memory>
+#include <set>
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/Value.h"
 #include "./include/KaleidoscopeJIT.h"
 #include "ast.h"
+#include "ast_visitor.h"
+#include "profiler.h"
+#include "type_inference.h"
+#include "builtins.h"
 
 namespace Rubiee {
 
-class ASTNodeVisitor {
-
-public:
-    virtual ~ASTNodeVisitor() = default;
-    virtual void visit(Expr &expr) = 0;
-    virtual void visit(Statement &stmt) = 0;
-    virtual void visit(IntConst &int_const) = 0;
-    virtual void visit(BinaryExpr &binary_expr) = 0;
-    virtual void visit(ComparisonExpr &comparison_expr) = 0;
-    virtual void visit(IfExpr &if_expr) = 0;
-    virtual void visit(ForLoopExpr &for_loop_expr) = 0;
-    virtual void visit(Variable &var) = 0;
-    virtual void visit(VariableAssignment &var_assignment) = 0;
-    virtual void visit(FunctionCall &function_call) = 0;
-    virtual void visit(FunctionPrototype &function_prototype) = 0;
-    virtual void visit(TopLevelExpr &top_level_expr) = 0;
-    virtual void visit(Function &function) = 0;
-};
-
 class CodeGenVisitor : public ASTNodeVisitor {
 
 public:
     CodeGenVisitor();
-    
+    // Generate code for `jit`, which scripts of an embedding host share
+    CodeGenVisitor(std::shared_ptr<llvm::orc::KaleidoscopeJIT> jit);
+    // Generate a required file into a module of its own. Its top level
+    // expressions go to `int entry_name()` instead of `main`, which runs them
+    // once and returns 1, or returns 0 if the file was already loaded. Its
+    // functions are exported as `<entry_name>.<name>.<types>`, once per
+    // signature of `TypeInference::exportedSignatures`.
+    CodeGenVisitor(const llvm::DataLayout &data_layout, std::string module_name, std::string entry_name);
+
+    // Initialize the native target and build a JIT, with the runtime bound
+    // in it, so that callers (e.g. the compile server) can pay this cost once
+    // and hand the JIT over later.
+    static std::unique_ptr<llvm::orc::KaleidoscopeJIT> createJIT();
+    // Resolve `symbol` to `address` in the code compiled by `jit`, whether the
+    // executable exports it or not
+    static void bindSymbol(llvm::orc::KaleidoscopeJIT &jit, const std::string &symbol, void *address);
+
     void visit(Expr &expr);
     void visit(Statement &stmt);
     void visit(IntConst &int_const);
+    void visit(FloatConst &float_const);
     void visit(BinaryExpr &binary_expr);
     void visit(ComparisonExpr &comparison_expr);
     void visit(IfExpr &if_expr);
+    void visit(CaseExpr &case_expr);
     void visit(ForLoopExpr &for_loop_expr);
+    void visit(RangeLoopExpr &range_loop_expr);
+    void visit(YieldExpr &yield_expr);
     void visit(Variable &var);
     void visit(VariableAssignment &var_assignment);
     void visit(FunctionCall &function_call);
+    void visit(Require &require);
     void visit(FunctionPrototype &function_prototype);
     void visit(TopLevelExpr &top_level_expr);
     void visit(Function &function);
 
+    typedef void (*MainFunction)();
+
+    // Hand the module to the JIT and return the address of `main`
+    MainFunction compileCode();
+    // The module handed to the JIT by `compileCode`
+    llvm::orc::KaleidoscopeJIT::ModuleHandleT moduleHandle() const;
+    // Symbols of the memo caches of the module, which keep the bignums they
+    // hold from being collected, see `_bignum_keep`
+    const std::vector<std::string> &memoCaches() const;
     void executeCode();
 
+    llvm::orc::KaleidoscopeJIT &getJIT();
+
+    // Type the code of `nodes`, and declare every specialization of the
+    // functions it defines, so they can be called before their definition
+    void declareFunctions(std::vector<ASTNode*> &nodes);
+    // Declare a function `name` defined by a required file, which exports a
+    // specialization `<symbol>.<types>` returning `return_types[i]` for every
+    // signature `i` of `TypeInference::exportedSignatures`. The JIT links calls
+    // to it. Functions defined by `nodes` win over it. Must be called before
+    // `declareFunctions`.
+    void importFunction(const std::string &name, const std::string &symbol, unsigned arg_num,
+                        const std::vector<NumericType> &return_types);
+
+    // Put a result cache of `cache_size` entries in front of `functions`,
+    // counting hits and misses if `stats` is set
+    void setMemoization(std::set<std::string> functions, unsigned cache_size, bool stats);
+    static const unsigned DEFAULT_MEMO_CACHE_SIZE = 1 << 14;
+    // Larger caches are capped
+    static const unsigned MAX_MEMO_CACHE_SIZE = 1 << 20;
+    // Name of the hit or miss counter of a memoized function
+    static std::string memoCounterName(const std::string &function, const std::string &counter);
+
+    // Let scripts call the native function `builtin.name`, the JIT must
+    // resolve `builtin.symbol`, see `bindSymbol`. Must be called before
+    // `declareFunctions`.
+    void addHostFunction(const Builtin &builtin);
+    // Export the specialization of `name` for `arg_types` as the C function
+    // `return_type entryName(name)(arg_types...)`. Must be called before
+    // `declareFunctions`, and `generateEntries` after it.
+    void addEntry(const std::string &name, NumericType return_type, const std::vector<NumericType> &arg_types);
+    // Returns false if an entry is not a function of the script
+    bool generateEntries();
+    static std::string entryName(const std::string &name);
+
+    // Let 64-bit integer arithmetic wrap around instead of overflowing into
+    // bignums, only meant to measure what the checks cost
+    void setOverflowChecks(bool checks);
+
+    // Finish the entry function of a required file and hand over its module
+    std::unique_ptr<llvm::Module> releaseModule();
+
+    // Emit line markers and keep the shadow call stack for the profiler, see
+    // `profiler.h`. `path` is the file being generated. Must be called before
+    // generating code.
+    void setProfiling(std::string path);
+
 private:
     // LLVM-related variables
     llvm::LLVMContext context;
@@ -64,18 +127,128 @@ private:
     // Symbol table
     std::map<std::string, llvm::AllocaInst *> variables;
 
+    // Types of the code being generated
+    TypeInference type_inference;
+    const TypeInference::Specialization *current_types;
+    std::set<std::string> defined_functions;
+
+    // Functions inlined because they were called with a block, variables of
+    // the innermost one are prefixed with `scope`
+    std::string scope;
+    const TypeInference::InlineFrame *inline_frame;
+
     // JIT
-    std::unique_ptr<llvm::orc::KaleidoscopeJIT> jit;
+    std::shared_ptr<llvm::orc::KaleidoscopeJIT> jit;
+    llvm::orc::KaleidoscopeJIT::ModuleHandleT module_handle;
+    std::vector<std::string> memo_caches;
     
     // Functions 
     std::map<std::string, llvm::Function*> stdlib_functions;
+    // Functions of required files by name, and the prefix of the symbols of
+    // the functions defined in this module
+    struct ImportedFunction {
+        std::string symbol;
+        unsigned arg_num;
+    };
+    std::map<std::string, ImportedFunction> imported_functions;
+    std::string function_prefix;
+    std::map<std::string, Builtin> host_functions;
+    struct Entry {
+        std::string name;
+        NumericType return_type;
+        std::vector<NumericType> arg_types;
+    };
+    std::vector<Entry> entries;
     // llvm::BasicBlock *main_function;
     llvm::Function *main_function;
 
+    // Memoization
+    std::set<std::string> memoized_functions;
+    unsigned memo_cache_bits;
+    bool memo_stats;
+
+    // Hash tables, see `runtime.h`
+    llvm::GlobalVariable *hash_tables;
+    llvm::GlobalVariable *hash_count;
+
+    // Bignums, see `runtime.h`
+    bool overflow_checks;
+
+    // Profiling
+    bool profile;
+    std::string profile_path;
+    llvm::GlobalVariable *profile_line;
+    llvm::GlobalVariable *profile_depth;
+    llvm::GlobalVariable *profile_stack;
+    // Depth to restore when a required file returns
+    llvm::Value *file_depth;
+
     // Methods
-    void initModule(std::unique_ptr<llvm::Module> &module, std::string module_name); 
+    void initModule(std::unique_ptr<llvm::Module> &module, std::string module_name, const llvm::DataLayout &data_layout); 
     void initStandardLibraryFunctions();
+    void declareStandardLibraryFunction(const Builtin &builtin);
+    // Builtin or host function called `name`, `nullptr` if there is none
+    const Builtin *findFunction(const std::string &name);
+    // Bind the symbols generated code uses to the runtime in this process, so
+    // they need not be exported by the executable embedding it
+    static void bindRuntimeSymbols(llvm::orc::KaleidoscopeJIT &jit);
     void initTopLevelExpr();
+    void initRequireEntry(std::string entry_name);
+    void markLine(int line);
+    // Enter a frame of the shadow call stack, returns the depth to restore
+    // when leaving it
+    llvm::Value *pushFrame(const std::string &name, int start_line, int end_line);
+    void popFrame(llvm::Value *depth);
+    void generateMemoCache(llvm::Function *fn, llvm::Function *body_fn, const std::string &name);
+    llvm::Function *declareSpecialization(const TypeInference::Specialization &specialization);
+    // Declare the specialization of an imported function for `arg_types`
+    llvm::Function *declareImport(const std::string &symbol, const TypeInference::Signature &arg_types, NumericType return_type);
+    void generateSpecialization(Function &function, const TypeInference::Specialization &specialization);
+    void generateInlineCall(FunctionCall &function_call, Function &definition, std::vector<llvm::Value *> &args);
+    // Assign `values` to the parameters of `block`, `0` to those left over
+    void bindBlockParams(Block &block, std::vector<llvm::Value *> &values);
+    // Stack slot of the variable `name`, scope included, allocated on first use
+    llvm::AllocaInst *variableFor(const std::string &name);
+    NumericType variableType(const std::string &name);
+    // Inline `hash_get` or `hash_has` of `key` in the home group of the
+    // table, calling `fallback` when the key may be in another group
+    llvm::Value *generateHashLookup(llvm::Function *fallback, llvm::Value *table, llvm::Value *key, bool has);
+    void generatePuts(std::vector<llvm::Value *> &args, std::vector<NumericType> &arg_types);
+    // 64-bit integer arithmetic of `binary_expr` and of the arithmetic under
+    // it, done again through the bignum runtime if any operation overflows or
+    // an operand which is not known to be a fixnum turns out to be a bignum
+    llvm::Value *generateCheckedArithmetic(BinaryExpr &binary_expr);
+    // The operands of the 64-bit integer arithmetic tree of `expr`, from left
+    // to right
+    void collectOperands(Expr *expr, std::vector<Expr *> &operands);
+    // The arithmetic tree of `expr` on the generated `values` of its operands,
+    // with overflow flags or'ed into `overflow`, through the bignum runtime if
+    // it is `nullptr`
+    llvm::Value *generateArithmetic(Expr *expr, std::map<Expr *, llvm::Value *> &values, llvm::Value **overflow);
+    // Compare 64-bit integers, going through the bignum runtime if either is one
+    llvm::Value *generateIntegerComparison(llvm::CmpInst::Predicate predicate, llvm::Value *lhs, llvm::Value *rhs, bool fixnums);
+    llvm::Function *bignumFunction(const char *symbol, llvm::Type *return_type, std::vector<llvm::Type *> arg_types);
+    // Whether the 64-bit `value` is the handle of a bignum
+    llvm::Value *isBignum(llvm::Value *value);
+    // Whether `expr` is known to be a fixnum without looking at its value
+    bool isFixnum(Expr *expr);
+    // Branch weights sending nearly every execution to the first successor
+    llvm::MDNode *likelyBranch();
+    // Promote variables to registers, inline small functions and simplify
+    // the code of the module before it is compiled
+    void optimizeModule();
+    llvm::Type *llvmType(NumericType type);
+    NumericType typeOf(Expr *expr);
+    // Convert the double `value` to the integer type `target`, saturating
+    // at its bounds, with NaN becoming `0`
+    llvm::Value *saturatingToInteger(llvm::Value *value, llvm::Type *target);
+    // Convert `value` to `type`, comparisons produce an `i1` which becomes `0`
+    // or `1`
+    llvm::Value *convert(llvm::Value *value, NumericType type);
+    // Whether `value` is not zero
+    llvm::Value *toCondition(llvm::Value *value);
+    // Generate a sequence of expressions, its value is the last one or `0`
+    llvm::Value *generateExprs(std::vector<Expr*> &exprs);
 };
 
 }
@@ -1,23 +1,279 @@
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <iostream>
+#include <iterator>
+#include <sstream>
 #include <memory>
 #include <vector>
 #include "lexer.h"
 #include "driver.h"
 #include "codegen_visitor.h"
+#include "pratt_parser.h"
+#include "ast_printer.h"
+#include "profiler.h"
+#include "module_loader.h"
+#include "purity_analysis.h"
+#include "runtime.h"
 
-Rubiee::Driver::Driver() : nodes(nullptr) {}
+static double elapsedMilliseconds(std::chrono::steady_clock::time_point since) {
+    return std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - since
+    ).count();
+}
+
+Rubiee::Driver::Driver() : nodes(nullptr), front_end(BISON), dump_ast(false), parse_only(false), profile(false), 
+                           memo_cache_size(CodeGenVisitor::DEFAULT_MEMO_CACHE_SIZE), memo_stats(false), hash_stats(false), overflow_checks(true), last_timings() {}
+
+Rubiee::Driver::Driver(std::unique_ptr<llvm::orc::KaleidoscopeJIT> jit) 
+                       : nodes(nullptr), front_end(BISON), dump_ast(false), parse_only(false), profile(false), 
+                         memo_cache_size(CodeGenVisitor::DEFAULT_MEMO_CACHE_SIZE), memo_stats(false), hash_stats(false), overflow_checks(true), 
+                         jit(std::move(jit)), last_timings() {}
+
+Rubiee::Driver::~Driver() = default;
 
 void Rubiee::Driver::set_nodes(std::vector<ASTNode*> *n) {
     nodes = n;
 }
 
-void Rubiee::Driver::parse(std::istream &input) {
-    Lexer lexer = Lexer(&input);
-    std::unique_ptr<Parser> parser( new Parser(lexer, *this) );
-    parser->parse();
+void Rubiee::Driver::set_front_end(FrontEnd f) {
+    front_end = f;
+}
+
+void Rubiee::Driver::set_dump_ast(bool d) {
+    dump_ast = d;
+}
+
+void Rubiee::Driver::set_parse_only(bool p) {
+    parse_only = p;
+}
+
+void Rubiee::Driver::set_profile(bool p) {
+    profile = p;
+}
+
+void Rubiee::Driver::set_memo_cache_size(unsigned size) {
+    memo_cache_size = size;
+}
+
+void Rubiee::Driver::set_memo_stats(bool stats) {
+    memo_stats = stats;
+}
+
+void Rubiee::Driver::set_hash_stats(bool stats) {
+    hash_stats = stats;
+}
+
+void Rubiee::Driver::set_overflow_checks(bool checks) {
+    overflow_checks = checks;
+}
+
+void Rubiee::Driver::set_source_path(std::string path) {
+    source_path = path;
+}
+
+bool Rubiee::Driver::set_option(const std::string &option) {
+    if (option == "--pratt") {
+        set_front_end(PRATT);
+    } else if (option == "--dump-ast") {
+        set_dump_ast(true);
+    } else if (option == "--parse-only") {
+        set_parse_only(true);
+    } else if (option == "--profile") {
+        set_profile(true);
+    } else if (option.compare(0, 12, "--memo-size=") == 0) {
+        unsigned size;
+        if (!parseUnsigned(option, "--memo-size=", size)) {
+            return false;
+        }
+        if (size > CodeGenVisitor::MAX_MEMO_CACHE_SIZE) {
+            fprintf(stderr, "`--memo-size` is at most %u.\n", CodeGenVisitor::MAX_MEMO_CACHE_SIZE);
+            return false;
+        }
+        set_memo_cache_size(size);
+    } else if (option == "--memo-stats") {
+        set_memo_stats(true);
+    } else if (option == "--hash-stats") {
+        set_hash_stats(true);
+    } else if (option == "--wrapping-integers") {
+        set_overflow_checks(false);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool Rubiee::Driver::parseUnsigned(const std::string &option, const std::string &prefix, unsigned &value) {
+    if (option.compare(0, prefix.size(), prefix) != 0) {
+        return false;
+    }
+    const char *text = option.c_str() + prefix.size();
+    char *end;
+    errno = 0;
+    unsigned long parsed = strtoul(text, &end, 10);
+    if (!isdigit((unsigned char) *text) || *end || errno == ERANGE || parsed > UINT_MAX) {
+        fprintf(stderr, "Invalid value `%s` for `%s`.\n", text, prefix.substr(0, prefix.size() - 1).c_str());
+        return false;
+    }
+    value = (unsigned) parsed;
+    return true;
+}
+
+const Rubiee::Driver::Timings &Rubiee::Driver::timings() const {
+    return last_timings;
+}
+
+bool Rubiee::Driver::parse(std::istream &input) {
+    auto start = std::chrono::steady_clock::now();
+
+    // The profile report quotes the source, so keep a copy of it
+    std::string source;
+    std::istringstream source_input;
+    if (profile) {
+        source.assign(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
+        source_input.str(source);
+    }
+
+    if (!parseNodes(profile ? source_input : input)) {
+        return false;
+    }
+    last_timings.parse_ms = elapsedMilliseconds(start);
+    if (parse_only) {
+        return true;
+    }
+
+    if (dump_ast) {
+        ASTPrinter printer(std::cout);
+        for (unsigned i = 0; i < nodes->size(); i++) {
+            ((*nodes)[i])->accept(printer);
+        }
+        return true;
+    }
+
+    // Creating the JIT initializes the native target, which the loader
+    // compiles required files for
+    start = std::chrono::steady_clock::now();
+    std::unique_ptr<CodeGenVisitor> codegen( 
+        jit ? new CodeGenVisitor(std::move(jit)) : new CodeGenVisitor() 
+    );
+    double setup_ms = elapsedMilliseconds(start);
+
+    // Required files are compiled in parallel into objects of their own
+    start = std::chrono::steady_clock::now();
+    size_t slash = source_path.rfind('/');
+    std::string base_dir = slash == std::string::npos ? "." : slash == 0 ? "/" : source_path.substr(0, slash);
+    ModuleLoader::Options options = { front_end, profile, memo_cache_size, memo_stats, overflow_checks };
+    ModuleLoader loader(options, base_dir + "/.rubiee-cache");
+    if (!loader.load(*nodes, base_dir)) {
+        return false;
+    }
+    last_timings.require_ms = elapsedMilliseconds(start);
+
+    start = std::chrono::steady_clock::now();
+    std::unique_ptr<Profiler> profiler;
+    if (profile) {
+        profiler.reset(new Profiler(source_path));
+        profiler->addFile(source_path, source);
+        loader.addToProfile(*profiler);
+        codegen->setProfiling(source_path);
+    }
 
-    std::unique_ptr<CodeGenVisitor> codegen( new CodeGenVisitor() );
+    // Functions of required files are called through the symbols they export
+    std::set<std::string> pure_imports;
+    const std::vector<ModuleLoader::ExportedFunction> &imports = loader.exports();
+    for (auto function = imports.begin(); function != imports.end(); ++function) {
+        codegen->importFunction(function->name, function->symbol, function->arg_num, function->return_types);
+        if (function->pure) {
+            pure_imports.insert(function->name);
+        }
+    }
+
+    PurityAnalysis purity;
+    purity.analyze(*nodes, pure_imports);
+    codegen->setMemoization(purity.memoizable(), memo_cache_size, memo_stats);
+    codegen->setOverflowChecks(overflow_checks);
+
+    codegen->declareFunctions(*nodes);
     for (unsigned i = 0; i < nodes->size(); i++) {
         ((*nodes)[i])->accept(*codegen);
     }
-    codegen->executeCode();
-}
\ No newline at end of file
+    for (auto object = loader.objects().begin(); object != loader.objects().end(); ++object) {
+        codegen->getJIT().addObject(std::move(*object));
+    }
+    CodeGenVisitor::MainFunction main_fn = codegen->compileCode();
+    last_timings.codegen_ms = setup_ms + elapsedMilliseconds(start);
+
+    start = std::chrono::steady_clock::now();
+    if (profiler) {
+        profiler->start();
+    }
+    main_fn();
+    if (profiler) {
+        profiler->stop();
+    }
+    last_timings.execute_ms = elapsedMilliseconds(start);
+
+    if (memo_stats) {
+        std::vector<std::pair<std::string, std::string>> memoized;
+        for (auto function = purity.memoizable().begin(); function != purity.memoizable().end(); ++function) {
+            memoized.push_back(std::make_pair(*function, *function));
+        }
+        std::vector<std::pair<std::string, std::string>> required = loader.memoized();
+        memoized.insert(memoized.end(), required.begin(), required.end());
+
+        fflush(stdout);
+        reportMemoStats(*codegen, memoized);
+    }
+
+    if (hash_stats) {
+        fflush(stdout);
+        reportHashStats(stderr);
+    }
+
+    if (profiler) {
+        fflush(stdout);
+        profiler->report(std::cerr);
+        std::string collapsed_stacks_path = source_path + ".folded";
+        if (!profiler->writeCollapsedStacks(collapsed_stacks_path)) {
+            fprintf(stderr, "Cannot write `%s`.\n", collapsed_stacks_path.c_str());
+        }
+    }
+
+    return true;
+}
+
+void Rubiee::Driver::reportMemoStats(CodeGenVisitor &codegen, const std::vector<std::pair<std::string, std::string>> &functions) {
+    for (auto function = functions.begin(); function != functions.end(); ++function) {
+        auto hits = codegen.getJIT().findSymbol(CodeGenVisitor::memoCounterName(function->second, "hits"));
+        auto misses = codegen.getJIT().findSymbol(CodeGenVisitor::memoCounterName(function->second, "misses"));
+        if (!hits || !misses) {
+            continue;
+        }
+
+        uint64_t hit_num = *(uint64_t *) (intptr_t) hits.getAddress();
+        uint64_t miss_num = *(uint64_t *) (intptr_t) misses.getAddress();
+        uint64_t call_num = hit_num + miss_num;
+        fprintf(stderr, "memo %s: %llu calls, %llu hits, %llu misses, %.1f%% hit rate\n",
+                function->first.c_str(),
+                (unsigned long long) call_num,
+                (unsigned long long) hit_num,
+                (unsigned long long) miss_num,
+                call_num ? 100.0 * hit_num / call_num : 0.0);
+    }
+}
+
+std::vector<Rubiee::ASTNode*> *Rubiee::Driver::parseNodes(std::istream &input) {
+    nodes = nullptr;
+
+    if (front_end == PRATT) {
+        PrattParser parser(input, *this);
+        return parser.parse() == 0 ? nodes : nullptr;
+    }
+
+    Lexer lexer = Lexer(&input);
+    std::unique_ptr<Parser> parser( new Parser(lexer, *this) );
+    return parser->parse() == 0 ? nodes : nullptr;
+}
@@ -1,22 +1,95 @@
 #ifndef __DRIVER_H__
 #define __DRIVER_H__ 1
 
+#include <memory>
+#include <utility>
+#include <string>
 #include <vector>
 #include "ast.h"
 
+namespace llvm {
+namespace orc {
+class KaleidoscopeJIT;
+}
+}
+
 namespace Rubiee {
 
+class CodeGenVisitor;
+
 class Driver {
 public:
+    // Wall-clock time spent in each phase of the last `parse` call
+    struct Timings {
+        double parse_ms;
+        double require_ms;
+        double codegen_ms;
+        double execute_ms;
+    };
+
+    enum FrontEnd {
+        BISON,
+        PRATT
+    };
+
     Driver();
+    // Use an already initialized JIT instead of building a new one
+    Driver(std::unique_ptr<llvm::orc::KaleidoscopeJIT> jit);
+    ~Driver();
 
     void set_nodes(std::vector<ASTNode*> *n);
-    void parse(std::istream &input);
+    void set_front_end(FrontEnd f);
+    // Print the AST instead of compiling and running it
+    void set_dump_ast(bool d);
+    // Stop after parsing, e.g. to time the front ends
+    void set_parse_only(bool p);
+    // Sample the script while it runs, report hot lines and loops on stderr
+    // and write collapsed stacks to `<source path>.folded`
+    void set_profile(bool p);
+    // Size of the result cache of memoized functions, and whether to
+    // report their hit rates on stderr
+    void set_memo_cache_size(unsigned size);
+    void set_memo_stats(bool stats);
+    // Report the load factor and probe lengths of every hash table on stderr
+    // once the script finishes
+    void set_hash_stats(bool stats);
+    // Integer arithmetic overflows into bignums unless this is turned off
+    void set_overflow_checks(bool checks);
+    // File the source is read from, reports name it and `require`s are
+    // resolved relative to it
+    void set_source_path(std::string path);
+    // Apply a command line option of `main`, such as `--pratt`. Returns false
+    // for unknown options and invalid values.
+    bool set_option(const std::string &option);
+    // Returns false if the source could not be parsed
+    bool parse(std::istream &input);
+    // Only run the front end, returns nullptr on syntax errors
+    std::vector<ASTNode*> *parseNodes(std::istream &input);
+
+    const Timings &timings() const;
+
+    // Parse `<prefix><value>`, reporting invalid values
+    static bool parseUnsigned(const std::string &option, const std::string &prefix, unsigned &value);
 
 private:
     std::vector<ASTNode*> *nodes;
+    FrontEnd front_end;
+    bool dump_ast;
+    bool parse_only;
+    bool profile;
+    std::string source_path;
+    unsigned memo_cache_size;
+    bool memo_stats;
+    bool hash_stats;
+    bool overflow_checks;
+    std::unique_ptr<llvm::orc::KaleidoscopeJIT> jit;
+    Timings last_timings;
+
+    // Report the counters of `functions`, given as a name to report and the
+    // symbol of the function
+    void reportMemoStats(CodeGenVisitor &codegen, const std::vector<std::pair<std::string, std::string>> &functions);
 };
 
 }
 
-#endif
\ No newline at end of file
+#endif
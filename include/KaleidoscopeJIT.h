@@ -27,10 +27,12 @@
 #include "llvm/ExecutionEngine/Orc/RTDyldObjectLinkingLayer.h"
 #include "llvm/IR/DataLayout.h"
 #include "llvm/IR/Mangler.h"
+#include "llvm/Object/ObjectFile.h"
 #include "llvm/Support/DynamicLibrary.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Target/TargetMachine.h"
 #include <algorithm>
+#include <map>
 #include <memory>
 #include <string>
 #include <vector>
@@ -71,6 +73,25 @@ public:
     return H;
   }
 
+  // Add an object file compiled ahead of time, e.g. loaded from a cache or
+  // compiled on another thread. It resolves symbols like modules do.
+  ModuleHandleT
+  addObject(std::unique_ptr<object::OwningBinary<object::ObjectFile>> Obj) {
+    auto Resolver = createLambdaResolver(
+        [&](const std::string &Name) {
+          if (auto Sym = findMangledSymbol(Name))
+            return Sym;
+          return JITSymbol(nullptr);
+        },
+        [](const std::string &S) { return nullptr; });
+    auto H = ObjectLayer.addObjectSet(singletonSet(std::move(Obj)),
+                                      make_unique<SectionMemoryManager>(),
+                                      std::move(Resolver));
+
+    ModuleHandles.push_back(H);
+    return H;
+  }
+
   void removeModule(ModuleHandleT H) {
     ModuleHandles.erase(find(ModuleHandles, H));
     CompileLayer.removeModuleSet(H);
@@ -80,6 +101,12 @@ public:
     return findMangledSymbol(mangle(Name));
   }
 
+  // Resolve `Name` to `Addr` in every module and object, before looking in
+  // the host process. Lets the host bind symbols it does not export.
+  void defineSymbol(const std::string &Name, JITTargetAddress Addr) {
+    BoundSymbols[mangle(Name)] = Addr;
+  }
+
 private:
   std::string mangle(const std::string &Name) {
     std::string MangledName;
@@ -110,6 +137,10 @@ private:
     const bool ExportedSymbolsOnly = true;
 #endif
 
+    auto Bound = BoundSymbols.find(Name);
+    if (Bound != BoundSymbols.end())
+      return JITSymbol(Bound->second, JITSymbolFlags::Exported);
+
     // Search modules in reverse order: from last added to first added.
     // This is the opposite of the usual search order for dlsym, but makes more
     // sense in a REPL where we want to bind to the newest available definition.
@@ -139,6 +170,7 @@ private:
   ObjLayerT ObjectLayer;
   CompileLayerT CompileLayer;
   std::vector<ModuleHandleT> ModuleHandles;
+  std::map<std::string, JITTargetAddress> BoundSymbols;
 };
 
 } // end namespace orc
@@ -1,10 +1,24 @@
+#include <iostream>
 #include "lexer.h"
 
 Rubiee::Lexer::Lexer(std::istream *in) 
-                     : yyFlexLexer(in), yylval(nullptr) {}
+                     : yyFlexLexer(in), yylval(nullptr), has_failed(false) {}
 
+bool Rubiee::Lexer::failed() const {
+    return has_failed;
+}
 
-int Rubiee::Lexer::yylex(Rubiee::Parser::semantic_type *l_val) {
+void Rubiee::Lexer::error(const std::string &err_message) {
+    std::cerr << "Error: " << err_message << "\n";
+    has_failed = true;
+}
+
+
+int Rubiee::Lexer::yylex(Rubiee::Parser::semantic_type *l_val, Rubiee::Parser::location_type *l_loc) {
     yylval = l_val;
-    return yylex();
-}
\ No newline at end of file
+    int token = yylex();
+
+    // Tokens never span lines, so the current line is the token's line
+    l_loc->begin.line = l_loc->end.line = lineno();
+    return token;
+}
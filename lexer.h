@@ -17,10 +17,16 @@ public:
     Lexer(std::istream *in);
 
     int yylex();
-    int yylex(Rubiee::Parser::semantic_type *l_val);
+    int yylex(Rubiee::Parser::semantic_type *l_val, Rubiee::Parser::location_type *l_loc);
+
+    // Whether the lexer reported an error, the parser then reports no other
+    bool failed() const;
 
 private:
     Rubiee::Parser::semantic_type *yylval;
+    bool has_failed;
+
+    void error(const std::string &err_message);
 };
 
 }
@@ -1,15 +1,67 @@
+#include <stdio.h>
+#include <stdlib.h>
 #include <fstream>
+#include <string>
+#include <vector>
 #include "driver.h"
+#include "server.h"
+#include "runtime.h"
 
+static int usage(const char *program) {
+    fprintf(stderr, "Usage: %s [options] <file> [data files...]\n"
+                    "       %s --server <socket> [--timeout=SECONDS]\n"
+                    "\n"
+                    "Options:\n"
+                    "  --pratt          Use the hand-written parser\n"
+                    "  --dump-ast       Print the AST instead of running the script\n"
+                    "  --parse-only     Only parse the script, e.g. to time the front ends\n"
+                    "  --profile        Report hot lines and loops, write <file>.folded\n"
+                    "  --memo-size=N    Entries in the result cache of memoized functions,\n"
+                    "                   up to 1048576\n"
+                    "  --memo-stats     Report hit rates of memoized functions\n"
+                    "  --hash-stats     Report load factors and probe lengths of hash tables\n"
+                    "  --wrapping-integers\n"
+                    "                   Let 64-bit integers wrap around instead of growing\n"
+                    "\n"
+                    "Server options:\n"
+                    "  --timeout=SECONDS  Kill scripts running longer (60 by default, 0 for none)\n", program, program);
+    return 1;
+}
 
 int main(int argc, char **argv)
 {
-
-    std::ifstream source_file (argv[1], std::ifstream::in);
+    if (argc >= 2 && std::string(argv[1]) == "--server") {
+        if (argc < 3 || argc > 4) {
+            return usage(argv[0]);
+        }
+        unsigned timeout = Rubiee::Server::DEFAULT_TIMEOUT;
+        if (argc == 4 && !Rubiee::Driver::parseUnsigned(argv[3], "--timeout=", timeout)) {
+            return usage(argv[0]);
+        }
+        Rubiee::Server server(argv[2], timeout);
+        return server.run();
+    }
 
     Rubiee::Driver *driver = new Rubiee::Driver();
-    driver->parse(source_file);
+
+    int arg = 1;
+    for (; arg < argc && argv[arg][0] == '-' && argv[arg][1] == '-'; arg++) {
+        if (!driver->set_option(argv[arg])) {
+            return usage(argv[0]);
+        }
+    }
+    if (arg >= argc) {
+        return usage(argv[0]);
+    }
+
+    // Data files are readable from scripts as input streams 1, 2, ...
+    Rubiee::setInputFiles(std::vector<std::string>(argv + arg + 1, argv + argc));
+
+    driver->set_source_path(argv[arg]);
+    std::ifstream source_file (argv[arg], std::ifstream::in);
+
+    bool ok = driver->parse(source_file);
 
     source_file.close();
-    return 0;
+    return ok ? 0 : 1;
 }
@@ -0,0 +1,554 @@
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include "module_loader.h"
+#include "ast_visitor.h"
+#include "codegen_visitor.h"
+#include "profiler.h"
+#include "purity_analysis.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/ExecutionEngine/ExecutionEngine.h"
+#include "llvm/ExecutionEngine/Orc/CompileUtils.h"
+#include "llvm/Object/ObjectFile.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+// Cached objects are only used by the build which compiled them, the
+// Makefile derives its ID from the sources
+#ifndef RUBIEE_BUILD_ID
+#define RUBIEE_BUILD_ID __DATE__ " " __TIME__
+#endif
+static const char *BUILD_ID = RUBIEE_BUILD_ID " llvm-" LLVM_VERSION_STRING;
+
+// 64-bit FNV-1a
+static uint64_t hashString(const std::string &data, uint64_t hash = 14695981039346656037ULL) {
+    for (size_t i = 0; i < data.size(); i++) {
+        hash ^= (unsigned char) data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static std::string hexString(uint64_t value) {
+    char buffer[17];
+    snprintf(buffer, sizeof(buffer), "%016llx", (unsigned long long) value);
+    return buffer;
+}
+
+static std::string directoryOf(const std::string &path) {
+    size_t slash = path.rfind('/');
+    if (slash == std::string::npos) {
+        return ".";
+    }
+    return slash == 0 ? "/" : path.substr(0, slash);
+}
+
+static bool canonicalPath(const std::string &path, std::string &canonical) {
+    char buffer[PATH_MAX];
+    if (!realpath(path.c_str(), buffer)) {
+        return false;
+    }
+    canonical = buffer;
+    return true;
+}
+
+namespace {
+
+// Collects every `require` of an AST, wherever it is nested
+class RequireCollector : public Rubiee::ASTNodeVisitor {
+public:
+    std::vector<Rubiee::Require*> requires;
+
+    void visit(Rubiee::Expr &expr) {}
+    void visit(Rubiee::Statement &stmt) {}
+    void visit(Rubiee::IntConst &int_const) {}
+    void visit(Rubiee::FloatConst &float_const) {}
+    void visit(Rubiee::Variable &var) {}
+
+    void visit(Rubiee::BinaryExpr &binary_expr) {
+        binary_expr.leftOperand->accept(*this);
+        binary_expr.rightOperand->accept(*this);
+    }
+
+    void visit(Rubiee::ComparisonExpr &comparison_expr) {
+        comparison_expr.leftOperand->accept(*this);
+        comparison_expr.rightOperand->accept(*this);
+    }
+
+    void visit(Rubiee::IfExpr &if_expr) {
+        if_expr.condition->accept(*this);
+        visitAll(if_expr.then_exprs);
+        visitAll(if_expr.else_exprs);
+    }
+
+    void visit(Rubiee::CaseExpr &case_expr) {
+        case_expr.subject->accept(*this);
+        for (auto when = case_expr.whens.begin(); when != case_expr.whens.end(); ++when) {
+            visitAll(when->values);
+            visitAll(when->body_exprs);
+        }
+        visitAll(case_expr.else_exprs);
+    }
+
+    void visit(Rubiee::ForLoopExpr &for_loop_expr) {
+        for_loop_expr.start_expr->accept(*this);
+        for_loop_expr.continue_condition->accept(*this);
+        for_loop_expr.step_expr->accept(*this);
+        visitAll(for_loop_expr.body_exprs);
+    }
+
+    void visit(Rubiee::RangeLoopExpr &range_loop_expr) {
+        range_loop_expr.first->accept(*this);
+        range_loop_expr.last->accept(*this);
+        visitAll(range_loop_expr.block->body_exprs);
+    }
+
+    void visit(Rubiee::YieldExpr &yield_expr) {
+        visitAll(yield_expr.args);
+    }
+
+    void visit(Rubiee::VariableAssignment &var_assignment) {
+        var_assignment.expr->accept(*this);
+    }
+
+    void visit(Rubiee::FunctionCall &function_call) {
+        visitAll(function_call.args);
+        if (function_call.block) {
+            visitAll(function_call.block->body_exprs);
+        }
+    }
+
+    void visit(Rubiee::Require &require) {
+        requires.push_back(&require);
+    }
+
+    void visit(Rubiee::FunctionPrototype &function_prototype) {}
+
+    void visit(Rubiee::TopLevelExpr &top_level_expr) {
+        top_level_expr.expr->accept(*this);
+    }
+
+    void visit(Rubiee::Function &function) {
+        visitAll(function.body_exprs);
+    }
+
+private:
+    void visitAll(std::vector<Rubiee::Expr*> &exprs) {
+        for (auto expr = exprs.begin(); expr != exprs.end(); ++expr) {
+            (*expr)->accept(*this);
+        }
+    }
+};
+
+}
+
+Rubiee::ModuleLoader::ModuleLoader(Options options, std::string cache_dir) 
+                                   : options(options), cache_dir(cache_dir), 
+                                     busy_workers(0), failed(false) {}
+
+Rubiee::ModuleLoader::~ModuleLoader() = default;
+
+std::vector<std::unique_ptr<Rubiee::ModuleLoader::Object>> &Rubiee::ModuleLoader::objects() {
+    return loaded_objects;
+}
+
+const std::vector<Rubiee::ModuleLoader::ExportedFunction> &Rubiee::ModuleLoader::exports() const {
+    return main_imports;
+}
+
+std::vector<std::pair<std::string, std::string>> Rubiee::ModuleLoader::memoized() const {
+    std::vector<std::pair<std::string, std::string>> functions;
+    for (auto file = files.begin(); file != files.end(); ++file) {
+        for (auto name = file->second.memoizable.begin(); name != file->second.memoizable.end(); ++name) {
+            functions.push_back(std::make_pair(*name + " (" + file->first + ")", functionSymbol(file->first, *name)));
+        }
+    }
+    return functions;
+}
+
+void Rubiee::ModuleLoader::addToProfile(Profiler &profiler) const {
+    for (auto file = files.begin(); file != files.end(); ++file) {
+        profiler.addFile(file->first, file->second.source);
+    }
+}
+
+std::string Rubiee::ModuleLoader::entryName(const std::string &path) {
+    return "__rubiee_require_" + hexString(hashString(path));
+}
+
+std::string Rubiee::ModuleLoader::functionSymbol(const std::string &path, const std::string &name) {
+    // See the constructor of `CodeGenVisitor` for required files
+    return entryName(path) + "." + name;
+}
+
+bool Rubiee::ModuleLoader::resolveRequires(std::vector<ASTNode*> &nodes, const std::string &base_dir,
+                                           std::vector<std::string> &requires) {
+    RequireCollector collector;
+    for (unsigned i = 0; i < nodes.size(); i++) {
+        nodes[i]->accept(collector);
+    }
+
+    bool ok = true;
+    for (auto require = collector.requires.begin(); require != collector.requires.end(); ++require) {
+        std::string path = (*require)->path;
+        if (path.empty() || path[0] != '/') {
+            path = base_dir + "/" + path;
+        }
+
+        // Like Ruby, the `.rb` extension can be left out
+        std::string canonical;
+        if (!canonicalPath(path, canonical) && !canonicalPath(path + ".rb", canonical)) {
+            fprintf(stderr, "Cannot find required file `%s`.\n", (*require)->path.c_str());
+            ok = false;
+            continue;
+        }
+
+        (*require)->symbol = entryName(canonical);
+        requires.push_back(canonical);
+    }
+    return ok;
+}
+
+bool Rubiee::ModuleLoader::load(std::vector<ASTNode*> &nodes, const std::string &base_dir) {
+    std::vector<std::string> requires;
+    if (!resolveRequires(nodes, base_dir, requires)) {
+        return false;
+    }
+    if (requires.empty()) {
+        return true;
+    }
+
+    enqueue(requires);
+    runWorkers(PARSE);
+    if (failed || !analyze() || !collectImports("", requires, main_imports)) {
+        return false;
+    }
+
+    mkdir(cache_dir.c_str(), 0755);
+    for (auto file = files.begin(); file != files.end(); ++file) {
+        queue.push_back(file->first);
+    }
+    runWorkers(COMPILE);
+    return !failed;
+}
+
+void Rubiee::ModuleLoader::enqueue(const std::vector<std::string> &paths) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto path = paths.begin(); path != paths.end(); ++path) {
+        if (seen.insert(*path).second) {
+            queue.push_back(*path);
+        }
+    }
+    queue_changed.notify_all();
+}
+
+void Rubiee::ModuleLoader::runWorkers(Phase phase) {
+    unsigned worker_num = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::thread> workers;
+    for (unsigned i = 0; i < worker_num; i++) {
+        workers.push_back(std::thread(&ModuleLoader::worker, this, phase));
+    }
+    for (auto worker = workers.begin(); worker != workers.end(); ++worker) {
+        worker->join();
+    }
+}
+
+void Rubiee::ModuleLoader::worker(Phase phase) {
+    // A TargetMachine must not be shared between threads
+    std::unique_ptr<llvm::TargetMachine> target_machine;
+    if (phase == COMPILE) {
+        target_machine.reset(llvm::EngineBuilder().selectTarget());
+    }
+
+    while (true) {
+        std::string path;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            // Done when nothing is queued and nobody can queue more
+            queue_changed.wait(lock, [this] { 
+                return !queue.empty() || busy_workers == 0 || failed; 
+            });
+            if (queue.empty() || failed) {
+                queue_changed.notify_all();
+                return;
+            }
+            path = queue.front();
+            queue.pop_front();
+            busy_workers++;
+        }
+
+        // Parsing adds files, compiling only touches the file compiled
+        bool ok;
+        File file;
+        std::unique_ptr<Object> object;
+        if (phase == PARSE) {
+            ok = parseFile(path, file);
+            if (ok) {
+                enqueue(file.requires);
+            }
+        } else {
+            ok = compileFile(path, *target_machine, object);
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!ok) {
+            failed = true;
+        } else if (phase == PARSE) {
+            files[path] = std::move(file);
+        } else {
+            loaded_objects.push_back(std::move(object));
+        }
+        busy_workers--;
+        queue_changed.notify_all();
+    }
+}
+
+bool Rubiee::ModuleLoader::parseFile(const std::string &path, File &file) {
+    std::ifstream input(path.c_str(), std::ifstream::in);
+    if (!input) {
+        fprintf(stderr, "Cannot open required file `%s`.\n", path.c_str());
+        return false;
+    }
+    std::stringstream content;
+    content << input.rdbuf();
+    file.source = content.str();
+    file.analyzed = false;
+
+    std::istringstream source(file.source);
+    Driver driver;
+    driver.set_front_end(options.front_end);
+    file.nodes = driver.parseNodes(source);
+    if (!file.nodes) {
+        fprintf(stderr, "Cannot parse required file `%s`.\n", path.c_str());
+        return false;
+    }
+    if (!resolveRequires(*file.nodes, directoryOf(path), file.requires)) {
+        return false;
+    }
+
+    for (auto node = file.nodes->begin(); node != file.nodes->end(); ++node) {
+        if (Function *function = dynamic_cast<Function *>(*node)) {
+            const std::string &name = function->proto->name;
+            unsigned arg_num = function->proto->args.size();
+            // Return types start from the smallest type, see `inferReturnTypes`
+            ExportedFunction exported = { 
+                name, path, functionSymbol(path, name), arg_num, false, 
+                std::vector<NumericType>(TypeInference::exportedSignatures(arg_num).size(), INT32) 
+            };
+            file.functions.push_back(exported);
+        }
+    }
+    return true;
+}
+
+bool Rubiee::ModuleLoader::analyze() {
+    // Whether the functions of a file are pure depends on the functions it
+    // imports, so files are analyzed after the files they require. Files
+    // requiring each other see the functions of those not analyzed yet as
+    // having side effects.
+    unsigned remaining = files.size();
+    while (remaining > 0) {
+        bool cyclic = true;
+        for (int pass = 0; pass < 2 && cyclic; pass++) {
+            for (auto entry = files.begin(); entry != files.end(); ++entry) {
+                File &file = entry->second;
+                if (file.analyzed) {
+                    continue;
+                }
+                bool ready = pass == 1 || std::all_of(file.requires.begin(), file.requires.end(), 
+                    [this, &entry](const std::string &path) { 
+                        return path == entry->first || files[path].analyzed; 
+                    });
+                if (!ready) {
+                    continue;
+                }
+
+                if (!collectImports(entry->first, file.requires, file.imports)) {
+                    return false;
+                }
+                std::set<std::string> pure_imports;
+                for (auto function = file.imports.begin(); function != file.imports.end(); ++function) {
+                    if (function->pure) {
+                        pure_imports.insert(function->name);
+                    }
+                }
+
+                PurityAnalysis purity;
+                purity.analyze(*file.nodes, pure_imports);
+                file.memoizable = purity.memoizable();
+                for (auto function = file.functions.begin(); function != file.functions.end(); ++function) {
+                    function->pure = purity.pure().count(function->name) > 0;
+                }
+
+                file.analyzed = true;
+                remaining--;
+                cyclic = false;
+                // Only one file at a time in a cycle
+                if (pass == 1) {
+                    break;
+                }
+            }
+        }
+    }
+
+    // Return types of imports only get larger, files are typed again until
+    // they do not
+    while (inferReturnTypes()) {}
+    return true;
+}
+
+bool Rubiee::ModuleLoader::inferReturnTypes() {
+    bool changed = false;
+    for (auto entry = files.begin(); entry != files.end(); ++entry) {
+        File &file = entry->second;
+
+        // The same analysis as the code generation of the file, see
+        // `CodeGenVisitor::declareFunctions`
+        TypeInference types;
+        for (auto function = file.imports.begin(); function != file.imports.end(); ++function) {
+            function->return_types = functionOf(function->path, function->name).return_types;
+            types.addImport(function->name, function->return_types);
+        }
+        types.exportFunctions(*file.nodes);
+        types.analyze(*file.nodes);
+
+        for (auto function = file.functions.begin(); function != file.functions.end(); ++function) {
+            std::vector<TypeInference::Signature> signatures = TypeInference::exportedSignatures(function->arg_num);
+            for (unsigned i = 0; i < signatures.size(); i++) {
+                const TypeInference::Specialization *specialization = types.find(function->name, signatures[i]);
+                if (specialization && specialization->return_type > function->return_types[i]) {
+                    function->return_types[i] = specialization->return_type;
+                    changed = true;
+                }
+            }
+        }
+    }
+    return changed;
+}
+
+const Rubiee::ModuleLoader::ExportedFunction &Rubiee::ModuleLoader::functionOf(const std::string &path, const std::string &name) {
+    std::vector<ExportedFunction> &functions = files[path].functions;
+    return *std::find_if(functions.begin(), functions.end(), 
+        [&name](const ExportedFunction &function) { return function.name == name; });
+}
+
+bool Rubiee::ModuleLoader::collectImports(const std::string &path, const std::vector<std::string> &requires,
+                                          std::vector<ExportedFunction> &imports) {
+    std::map<std::string, const ExportedFunction *> by_name;
+    std::set<std::string> visited;
+    std::vector<std::string> pending(requires.begin(), requires.end());
+    imports.clear();
+
+    while (!pending.empty()) {
+        std::string required = pending.back();
+        pending.pop_back();
+        if (required == path || !visited.insert(required).second) {
+            continue;
+        }
+
+        const File &file = files[required];
+        for (auto function = file.functions.begin(); function != file.functions.end(); ++function) {
+            auto other = by_name.find(function->name);
+            if (other != by_name.end()) {
+                fprintf(stderr, "Function `%s` is defined by both `%s` and `%s`.\n",
+                        function->name.c_str(), other->second->path.c_str(), function->path.c_str());
+                return false;
+            }
+            by_name[function->name] = &*function;
+        }
+        pending.insert(pending.end(), file.requires.begin(), file.requires.end());
+    }
+
+    for (auto function = by_name.begin(); function != by_name.end(); ++function) {
+        imports.push_back(*function->second);
+    }
+    return true;
+}
+
+bool Rubiee::ModuleLoader::compileFile(const std::string &path, llvm::TargetMachine &target_machine, std::unique_ptr<Object> &object) {
+    File &file = files[path];
+
+    // The code of the files it requires is only reached through their entry
+    // and exported functions, named after their paths, so only what it sees
+    // of them is part of the key
+    std::ostringstream key;
+    key << BUILD_ID << "\n"
+        << "profile=" << options.profile << " memo_cache_size=" << options.memo_cache_size
+        << " memo_stats=" << options.memo_stats << " overflow_checks=" << options.overflow_checks << "\n";
+    for (auto function = file.imports.begin(); function != file.imports.end(); ++function) {
+        key << "import " << function->name << " " << function->symbol << " " 
+            << function->arg_num << " " << function->pure;
+        for (auto type = function->return_types.begin(); type != function->return_types.end(); ++type) {
+            key << " " << numericTypeName(*type);
+        }
+        key << "\n";
+    }
+    key << file.source;
+    std::string cache_path = cache_dir + "/" + hexString(hashString(path)) + "-" + hexString(hashString(key.str()));
+    if (loadCachedFile(cache_path, object)) {
+        return true;
+    }
+
+    CodeGenVisitor codegen(target_machine.createDataLayout(), path, entryName(path));
+    if (options.profile) {
+        codegen.setProfiling(path);
+    }
+    codegen.setMemoization(file.memoizable, options.memo_cache_size, options.memo_stats);
+    codegen.setOverflowChecks(options.overflow_checks);
+    for (auto function = file.imports.begin(); function != file.imports.end(); ++function) {
+        codegen.importFunction(function->name, function->symbol, function->arg_num, function->return_types);
+    }
+    codegen.declareFunctions(*file.nodes);
+    for (unsigned i = 0; i < file.nodes->size(); i++) {
+        ((*file.nodes)[i])->accept(codegen);
+    }
+    std::unique_ptr<llvm::Module> module = codegen.releaseModule();
+
+    llvm::orc::SimpleCompiler compile(target_machine);
+    object = llvm::make_unique<Object>(compile(*module));
+    if (!object->getBinary()) {
+        fprintf(stderr, "Cannot compile required file `%s`.\n", path.c_str());
+        return false;
+    }
+
+    storeCachedFile(cache_path, *object);
+    return true;
+}
+
+// A cached file is the object file `<cache_path>.o`
+bool Rubiee::ModuleLoader::loadCachedFile(const std::string &cache_path, std::unique_ptr<Object> &object) {
+    auto buffer = llvm::MemoryBuffer::getFile(cache_path + ".o");
+    if (!buffer) {
+        return false;
+    }
+    auto object_file = llvm::object::ObjectFile::createObjectFile((*buffer)->getMemBufferRef());
+    if (!object_file) {
+        llvm::consumeError(object_file.takeError());
+        return false;
+    }
+
+    object = llvm::make_unique<Object>(std::move(*object_file), std::move(*buffer));
+    return true;
+}
+
+void Rubiee::ModuleLoader::storeCachedFile(const std::string &cache_path, const Object &object) {
+    // Write to a temporary file first, other processes may read the cache
+    std::string temporary_path = cache_path + ".o." + std::to_string(getpid()) + ".tmp";
+
+    llvm::StringRef data = object.getBinary()->getData();
+    std::ofstream object_file(temporary_path.c_str(), std::ofstream::binary);
+    object_file.write(data.data(), data.size());
+    object_file.close();
+
+    if (!object_file) {
+        unlink(temporary_path.c_str());
+        return;
+    }
+    rename(temporary_path.c_str(), (cache_path + ".o").c_str());
+}
@@ -0,0 +1,147 @@
+#ifndef __MODULE_LOADER_H__
+#define __MODULE_LOADER_H__ 1
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+#include "ast.h"
+#include "driver.h"
+#include "type_inference.h"
+
+namespace llvm {
+class TargetMachine;
+namespace object {
+class ObjectFile;
+template <typename T> class OwningBinary;
+}
+}
+
+namespace Rubiee {
+
+class Profiler;
+
+// Loads the files named by `require`, and everything they require in turn.
+//
+// Every file is lexed and parsed on a worker thread, then code-generated and
+// compiled to an object file, into a module of its own. Its functions are
+// exported once per signature of `TypeInference::exportedSignatures`, and
+// calls to the functions of the files it requires, directly or not, are
+// linked by the JIT. Objects are cached on disk, keyed by the file's
+// path and content, the compile options, the build, and the interface of the
+// functions it imports, so a file is only compiled again when one of them
+// changes, not when the code of the files it requires or is required by does.
+//
+// Workers compile for the native target, which must be initialized first,
+// e.g. by creating the JIT.
+class ModuleLoader {
+public:
+    typedef llvm::object::OwningBinary<llvm::object::ObjectFile> Object;
+
+    // How files are parsed and compiled, the compile options are part of the
+    // key of cached objects
+    struct Options {
+        Driver::FrontEnd front_end;
+        bool profile;
+        unsigned memo_cache_size;
+        bool memo_stats;
+        bool overflow_checks;
+    };
+
+    // A function defined by a loaded file, as seen by the files calling it
+    struct ExportedFunction {
+        std::string name;
+        std::string path;
+        std::string symbol;
+        unsigned arg_num;
+        bool pure;
+        // Return type of every exported specialization
+        std::vector<NumericType> return_types;
+    };
+
+    ModuleLoader(Options options, std::string cache_dir);
+    ~ModuleLoader();
+
+    // Resolve the `require`s of `nodes`, parsed from a file in `base_dir`, and
+    // load the required files. Returns false if any of them cannot be loaded.
+    bool load(std::vector<ASTNode*> &nodes, const std::string &base_dir);
+
+    // Compiled objects of all loaded files
+    std::vector<std::unique_ptr<Object>> &objects();
+
+    // Functions the files required by `nodes` define, directly or not
+    const std::vector<ExportedFunction> &exports() const;
+
+    // Memoized functions of all loaded files, as a name to report and the
+    // symbol of the function
+    std::vector<std::pair<std::string, std::string>> memoized() const;
+
+    // Register the source of every loaded file with `profiler`
+    void addToProfile(Profiler &profiler) const;
+
+    // Name of the entry function of the file at `path`
+    static std::string entryName(const std::string &path);
+    // Symbol of the function `name` defined by the file at `path`
+    static std::string functionSymbol(const std::string &path, const std::string &name);
+
+private:
+    struct File {
+        std::string source;
+        std::vector<ASTNode*> *nodes;
+        std::vector<std::string> requires;
+        // Its own functions, and the functions of the files it requires
+        std::vector<ExportedFunction> functions;
+        std::vector<ExportedFunction> imports;
+        std::set<std::string> memoizable;
+        bool analyzed;
+    };
+
+    // Files are parsed first, discovering the files they require, then
+    // compiled once every file is parsed and analyzed
+    enum Phase {
+        PARSE,
+        COMPILE
+    };
+
+    Options options;
+    std::string cache_dir;
+
+    std::mutex mutex;
+    std::condition_variable queue_changed;
+    std::deque<std::string> queue;
+    std::set<std::string> seen;
+    unsigned busy_workers;
+    bool failed;
+    std::map<std::string, File> files;
+    std::vector<std::unique_ptr<Object>> loaded_objects;
+    std::vector<ExportedFunction> main_imports;
+
+    void enqueue(const std::vector<std::string> &paths);
+    void runWorkers(Phase phase);
+    void worker(Phase phase);
+    bool parseFile(const std::string &path, File &file);
+    bool analyze();
+    // Infer the return types of the exported functions of every file, returns
+    // whether any of them got larger
+    bool inferReturnTypes();
+    const ExportedFunction &functionOf(const std::string &path, const std::string &name);
+    bool compileFile(const std::string &path, llvm::TargetMachine &target_machine, std::unique_ptr<Object> &object);
+    bool loadCachedFile(const std::string &cache_path, std::unique_ptr<Object> &object);
+    void storeCachedFile(const std::string &cache_path, const Object &object);
+
+    // The functions of `requires` and of the files they require, reports
+    // functions defined by two files
+    bool collectImports(const std::string &path, const std::vector<std::string> &requires,
+                        std::vector<ExportedFunction> &imports);
+
+    static bool resolveRequires(std::vector<ASTNode*> &nodes, const std::string &base_dir,
+                                std::vector<std::string> &requires);
+};
+
+}
+
+#endif
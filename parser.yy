@@ -2,6 +2,7 @@
 %require "3.0"
 
 %verbose
+%locations
 
 %defines
 %define api.namespace {Rubiee}
@@ -22,106 +23,234 @@
 
 %code{
   static int yylex(Rubiee::Parser::semantic_type *yylval,
+                   Rubiee::Parser::location_type *yylloc,
                    Rubiee::Lexer &lexer);
 
-  static std::vector<Rubiee::ASTNode*> *transformTopLevelExprsIntoFunctions(std::vector<Rubiee::ASTNode*> *nodes) {
-        for (unsigned i = 0; i < nodes->size(); i++) {
-                (*nodes)[i] = new Rubiee::TopLevelExpr(
-                        static_cast<Rubiee::Expr*>( (*nodes)[i] )
-                );
-        }
-        return nodes;
+  template <typename T>
+  static T *located(T *node, const Rubiee::Parser::location_type &loc) {
+        node->line = loc.begin.line;
+        return node;
   }
 
 }
 
 %union {
   std::string *str_const;
-  int int_const;
+  long long int_const;
+  double float_const;
 
   Expr *expr;
+  ASTNode *node;
+  Function *function;
+  std::vector<std::string> *strs;
   std::vector<ASTNode*> *nodes;
   std::vector<Expr*> *exprs;
+  WhenClause *when;
+  std::vector<WhenClause> *whens;
+  Block *block;
 }
 
 %token <int_const> INT_CONST
+%token <float_const> FLOAT_CONST
 %token <str_const> IDENTIFIER
+%token <str_const> STRING_CONST
+%token REQUIRE
+%token DEF
+%token MEMO
 %token IF
 %token FOR
 %token ELSE
+%token CASE
+%token WHEN
+%token DO
+%token YIELD
 %token END
 %token SEMICOLON
 %token ASSIGNMENT
 %token COMMA
 %token L_PAREN
+%token CALL_L_PAREN
 %token R_PAREN
+%token DOT
+%token DOT2
+%token DOT3
+%token PIPE
+// Characters no token starts with, and out of range integers
+%token UNKNOWN
 
+// The value of an assignment extends as far as it can, e.g. `x = 3.times do`
+%right ASSIGNMENT
 %left GREATER_THAN LESS_THAN EQUAL GREATER_THAN_OR_EQUAL LESS_THAN_OR_EQUAL
 %left PLUS MINUS
 %left MUL DIV
+%left DOT
 
 %type <nodes> nodes
+%type <node> node
+%type <function> def
+%type <strs> params
 %type <exprs> exprs
 %type <expr> expr
 %type <exprs> args
+%type <when> when
+%type <whens> whens
+%type <block> block
 
 %start top
 
 %%
 
-top : nodes { driver.set_nodes(transformTopLevelExprsIntoFunctions($1)); }
+top : nodes { driver.set_nodes($1); }
     ;
 
-nodes : exprs {
-                $$ = new std::vector<ASTNode*>();
-                for (unsigned i = 0; i < $1->size(); i++) {
-                        $$->push_back( (*$1)[i] );
-                }
+nodes : node { $$ = new std::vector<ASTNode*>(); $$->push_back($1); }
+      | nodes node { $$ = $1; $$->push_back($2); }
+      ;
+
+// All top level expressions are placed in `main`
+node  : expr { $$ = located(new TopLevelExpr($1), @$); }
+      | def { $$ = $1; }
+      | MEMO def { $$ = $2; $2->memo = true; }
+      ;
+
+def   : DEF IDENTIFIER def_paren params R_PAREN exprs END {
+                $$ = located(new Function(
+                        located(new FunctionPrototype(*$2, std::move(*$4)), @$),
+                        std::move(*$6)
+                     ), @$);
+                delete $2;
+        }
+      | DEF IDENTIFIER def_paren R_PAREN exprs END {
+                $$ = located(new Function(
+                        located(new FunctionPrototype(*$2, std::vector<std::string>()), @$),
+                        std::move(*$5)
+                     ), @$);
+                delete $2;
         }
       ;
 
+// The parameters of a definition may start on the line after its name
+def_paren : L_PAREN
+          | CALL_L_PAREN
+          ;
+
+params : IDENTIFIER { $$ = new std::vector<std::string>(); $$->push_back(*$1); delete $1; }
+       | params COMMA IDENTIFIER { $$ = $1; $$->push_back(*$3); delete $3; }
+       ;
+
 exprs   : expr { $$ = new std::vector<Expr*>(); $$->push_back($1); }
         | exprs expr { $$ = $1; $$->push_back($2); }
         ;
 
-expr    : INT_CONST { $$ = new IntConst($1); }
-        | expr PLUS expr { $$ = new BinaryExpr($1, $3, '+'); }
-        | expr MINUS expr { $$ = new BinaryExpr($1, $3, '-'); }
-        | expr MUL expr { $$ = new BinaryExpr($1, $3, '*'); }
-        | expr GREATER_THAN_OR_EQUAL expr { $$ = new ComparisonExpr($1, $3, ">="); }
-        | expr LESS_THAN_OR_EQUAL expr { $$ = new ComparisonExpr($1, $3, "<="); }
-        | expr GREATER_THAN expr { $$ = new ComparisonExpr($1, $3, ">"); }
-        | expr LESS_THAN expr { $$ = new ComparisonExpr($1, $3, "<"); }
-        | expr EQUAL expr { $$ = new ComparisonExpr($1, $3, "=="); }
+expr    : INT_CONST { $$ = located(new IntConst($1), @$); }
+        | FLOAT_CONST { $$ = located(new FloatConst($1), @$); }
+        | expr PLUS expr { $$ = located(new BinaryExpr($1, $3, '+'), @$); }
+        | expr MINUS expr { $$ = located(new BinaryExpr($1, $3, '-'), @$); }
+        | expr MUL expr { $$ = located(new BinaryExpr($1, $3, '*'), @$); }
+        | expr GREATER_THAN_OR_EQUAL expr { $$ = located(new ComparisonExpr($1, $3, ">="), @$); }
+        | expr LESS_THAN_OR_EQUAL expr { $$ = located(new ComparisonExpr($1, $3, "<="), @$); }
+        | expr GREATER_THAN expr { $$ = located(new ComparisonExpr($1, $3, ">"), @$); }
+        | expr LESS_THAN expr { $$ = located(new ComparisonExpr($1, $3, "<"), @$); }
+        | expr EQUAL expr { $$ = located(new ComparisonExpr($1, $3, "=="), @$); }
         | IF expr exprs END { 
-                $$ = new IfExpr( 
+                $$ = located(new IfExpr( 
                         $2, 
                         *$3, 
                         std::vector<Expr*>() 
-                     ); 
+                     ), @$); 
           }
         | IF expr exprs ELSE exprs END { 
-                $$ = new IfExpr(
+                $$ = located(new IfExpr(
                         $2, 
                         *$3, 
                         *$5
-                     ); 
+                     ), @$); 
+          }
+        | CASE expr whens END {
+                $$ = located(new CaseExpr(
+                        $2,
+                        std::move(*$3),
+                        std::vector<Expr*>()
+                     ), @$);
+          }
+        | CASE expr whens ELSE exprs END {
+                $$ = located(new CaseExpr(
+                        $2,
+                        std::move(*$3),
+                        std::move(*$5)
+                     ), @$);
           }
         | FOR expr SEMICOLON expr SEMICOLON expr exprs END { 
-                $$ = new ForLoopExpr($2, $4, $6, std::move(*$7)); 
+                ForLoopExpr *loop = located(new ForLoopExpr($2, $4, $6, std::move(*$7)), @$);
+                loop->end_line = @8.begin.line;
+                $$ = loop;
           }
-        | IDENTIFIER L_PAREN args R_PAREN { $$ = new FunctionCall( *$1, std::move(*$3) ); }
+        | expr DOT IDENTIFIER block {
+                if (*$3 != "times") {
+                        error(@3, "undefined method `" + *$3 + "`");
+                        delete $3;
+                        YYERROR;
+                }
+                $$ = located(new RangeLoopExpr(located(new IntConst(0), @1), $1, true, $4), @$);
+                delete $3;
+          }
+        | L_PAREN expr DOT2 expr R_PAREN DOT IDENTIFIER block {
+                if (*$7 != "each") {
+                        error(@7, "undefined method `" + *$7 + "`");
+                        delete $7;
+                        YYERROR;
+                }
+                $$ = located(new RangeLoopExpr($2, $4, false, $8), @$);
+                delete $7;
+          }
+        | L_PAREN expr DOT3 expr R_PAREN DOT IDENTIFIER block {
+                if (*$7 != "each") {
+                        error(@7, "undefined method `" + *$7 + "`");
+                        delete $7;
+                        YYERROR;
+                }
+                $$ = located(new RangeLoopExpr($2, $4, true, $8), @$);
+                delete $7;
+          }
+        | YIELD { $$ = located(new YieldExpr(std::vector<Expr*>()), @$); }
+        | YIELD CALL_L_PAREN args R_PAREN { $$ = located(new YieldExpr(std::move(*$3)), @$); }
+        | YIELD CALL_L_PAREN R_PAREN { $$ = located(new YieldExpr(std::vector<Expr*>()), @$); }
+        | IDENTIFIER CALL_L_PAREN args R_PAREN { $$ = located(new FunctionCall( *$1, std::move(*$3) ), @$); }
+        | IDENTIFIER CALL_L_PAREN args R_PAREN block { $$ = located(new FunctionCall( *$1, std::move(*$3), $5 ), @$); }
+        | IDENTIFIER CALL_L_PAREN R_PAREN { $$ = located(new FunctionCall( *$1, std::vector<Expr*>() ), @$); }
+        | IDENTIFIER CALL_L_PAREN R_PAREN block { $$ = located(new FunctionCall( *$1, std::vector<Expr*>(), $4 ), @$); }
         | IDENTIFIER { 
-                $$ = new Variable(*$1); 
+                $$ = located(new Variable(*$1), @$); 
                 delete $1;
           }
         | IDENTIFIER ASSIGNMENT expr { 
-                $$ = new VariableAssignment(
-                        new Variable(*$1),
+                $$ = located(new VariableAssignment(
+                        located(new Variable(*$1), @1),
                         $3
-                ); 
+                ), @$); 
                 delete $1;
           }
+        | REQUIRE STRING_CONST {
+                $$ = located(new Require(*$2), @$);
+                delete $2;
+          }
+        ;
+
+whens   : when { $$ = new std::vector<WhenClause>(); $$->push_back(std::move(*$1)); }
+        | whens when { $$ = $1; $$->push_back(std::move(*$2)); }
+        ;
+
+when    : WHEN args exprs { $$ = new WhenClause(std::move(*$2), std::move(*$3)); }
+        ;
+
+block   : DO exprs END {
+                $$ = new Block(std::vector<std::string>(), std::move(*$2));
+                $$->end_line = @3.begin.line;
+          }
+        | DO PIPE params PIPE exprs END {
+                $$ = new Block(std::move(*$3), std::move(*$5));
+                $$->end_line = @6.begin.line;
+          }
         ;
 
 args    : expr { $$ = new std::vector<Expr*>(); $$->push_back($1); }
@@ -133,12 +262,16 @@ args    : expr { $$ = new std::vector<Expr*>(); $$->push_back($1); }
 #include "lexer.h"
 
 static int yylex(Rubiee::Parser::semantic_type *yylval,
+                 Rubiee::Parser::location_type *yylloc,
                  Rubiee::Lexer &lexer) {
-    return lexer.yylex(yylval);
+    return lexer.yylex(yylval, yylloc);
 }
 
 void
-Rubiee::Parser::error( const std::string &err_message )
+Rubiee::Parser::error( const location_type &loc, const std::string &err_message )
 {
-   std::cerr << "Error: " << err_message << "\n";
+   // Only the first error is reported, like the Pratt parser does
+   if (!lexer.failed()) {
+        std::cerr << "Error: " << err_message << "\n";
+   }
 }
@@ -0,0 +1,639 @@
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include "pratt_parser.h"
+#include "driver.h"
+
+template <typename T>
+static inline T *located(T *node, int line) {
+    node->line = line;
+    return node;
+}
+
+Rubiee::PrattParser::PrattParser(std::istream &input, Driver &driver) 
+                                 : driver(driver), line(1), token(), failed(false) {
+    source.assign(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
+    cursor = source.data();
+    end = cursor + source.size();
+}
+
+int Rubiee::PrattParser::parse() {
+    next();
+
+    // top : nodes, node : expr | def | MEMO def
+    std::unique_ptr<std::vector<ASTNode*>> nodes(new std::vector<ASTNode*>());
+    do {
+        ASTNode *node;
+        if (token.type == DEF || token.type == MEMO) {
+            node = parseDef();
+        } else {
+            // All top level expressions are placed in `main`
+            Expr *expr = parseExpr(0);
+            node = expr ? located(new TopLevelExpr(expr), expr->line) : nullptr;
+        }
+        if (!node) {
+            return 1;
+        }
+        nodes->push_back(node);
+    } while (token.type != END_OF_INPUT);
+
+    driver.set_nodes(nodes.release());
+    return 0;
+}
+
+static inline bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+static inline bool isAlpha(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+void Rubiee::PrattParser::next() {
+    bool callee = token.type == IDENTIFIER || token.type == YIELD;
+    while (cursor < end && (*cursor == ' ' || *cursor == '\t' || *cursor == '\r' || *cursor == '\n')) {
+        if (*cursor == '\n') {
+            callee = false;
+            ++line;
+        }
+        ++cursor;
+    }
+
+    token.text = cursor;
+    token.length = 1;
+    token.line = line;
+
+    if (cursor == end) {
+        token.type = END_OF_INPUT;
+        token.length = 0;
+        return;
+    }
+
+    char c = *cursor;
+
+    // 0|[1-9][0-9]*
+    if (isDigit(c)) {
+        const char *start = cursor;
+        long long value = *cursor++ - '0';
+        bool out_of_range = false;
+        if (c != '0') {
+            while (cursor < end && isDigit(*cursor)) {
+                int digit = *cursor++ - '0';
+                if (value > (std::numeric_limits<long long>::max() - digit) / 10) {
+                    out_of_range = true;
+                } else {
+                    value = value * 10 + digit;
+                }
+            }
+        }
+
+        // (0|[1-9][0-9]*)\.[0-9]+([eE][-+]?[0-9]+)?, `1.` and `1.e5` are
+        // not floats, like in Ruby
+        if (cursor + 1 < end && *cursor == '.' && isDigit(cursor[1])) {
+            for (++cursor; cursor < end && isDigit(*cursor); ++cursor) {}
+            const char *exponent = cursor;
+            if (cursor < end && (*cursor == 'e' || *cursor == 'E')) {
+                ++cursor;
+                if (cursor < end && (*cursor == '-' || *cursor == '+')) {
+                    ++cursor;
+                }
+                if (cursor < end && isDigit(*cursor)) {
+                    for (; cursor < end && isDigit(*cursor); ++cursor) {}
+                } else {
+                    cursor = exponent;
+                }
+            }
+            token.type = FLOAT_CONST;
+            token.length = cursor - start;
+            token.float_const = strtod(std::string(start, token.length).c_str(), nullptr);
+            return;
+        }
+
+        if (out_of_range) {
+            token.type = UNKNOWN;
+            error("integer constant is out of range");
+            return;
+        }
+        token.type = INT_CONST;
+        token.length = cursor - start;
+        token.int_const = value;
+        return;
+    }
+
+    // [a-zA-Z][a-zA-Z0-9_]*, keywords included
+    if (isAlpha(c)) {
+        const char *start = cursor;
+        while (cursor < end && (isAlpha(*cursor) || isDigit(*cursor) || *cursor == '_')) {
+            ++cursor;
+        }
+        token.length = cursor - start;
+        token.type = IDENTIFIER;
+
+        if (token.length == 2 && memcmp(start, "if", 2) == 0) {
+            token.type = IF;
+        } else if (token.length == 3 && memcmp(start, "for", 3) == 0) {
+            token.type = FOR;
+        } else if (token.length == 3 && memcmp(start, "def", 3) == 0) {
+            token.type = DEF;
+        } else if (token.length == 4 && memcmp(start, "memo", 4) == 0) {
+            token.type = MEMO;
+        } else if (token.length == 3 && memcmp(start, "end", 3) == 0) {
+            token.type = END;
+        } else if (token.length == 4 && memcmp(start, "case", 4) == 0) {
+            token.type = CASE;
+        } else if (token.length == 4 && memcmp(start, "when", 4) == 0) {
+            token.type = WHEN;
+        } else if (token.length == 4 && memcmp(start, "else", 4) == 0) {
+            token.type = ELSE;
+        } else if (token.length == 7 && memcmp(start, "require", 7) == 0) {
+            token.type = REQUIRE;
+        } else if (token.length == 2 && memcmp(start, "do", 2) == 0) {
+            token.type = DO;
+        } else if (token.length == 5 && memcmp(start, "yield", 5) == 0) {
+            token.type = YIELD;
+        }
+        return;
+    }
+
+    // \"[^"\n]*\", the token text excludes the quotes
+    if (c == '"') {
+        const char *start = ++cursor;
+        while (cursor < end && *cursor != '"' && *cursor != '\n') {
+            ++cursor;
+        }
+        if (cursor == end || *cursor != '"') {
+            token.type = UNKNOWN;
+            return;
+        }
+        token.type = STRING_CONST;
+        token.text = start;
+        token.length = cursor - start;
+        ++cursor;
+        return;
+    }
+
+    ++cursor;
+    switch (c) {
+    case '>':
+    case '<':
+    case '=':
+        if (cursor < end && *cursor == '=') {
+            ++cursor;
+            token.length = 2;
+            token.type = c == '>' ? GREATER_THAN_OR_EQUAL :
+                         c == '<' ? LESS_THAN_OR_EQUAL : EQUAL;
+        } else {
+            token.type = c == '>' ? GREATER_THAN :
+                         c == '<' ? LESS_THAN : ASSIGNMENT;
+        }
+        break;
+    case '+': token.type = PLUS; break;
+    case '-': token.type = MINUS; break;
+    case '*': token.type = MUL; break;
+    case '%': token.type = DIV; break;
+    case ',': token.type = COMMA; break;
+    case ';': token.type = SEMICOLON; break;
+    case '(':
+        // `f (1)` is a call, `f` then `(1..3).each` on the next line a
+        // variable and a loop
+        token.type = callee ? CALL_L_PAREN : L_PAREN;
+        break;
+    case ')': token.type = R_PAREN; break;
+    case '|': token.type = PIPE; break;
+    case '.':
+        // "...", ".." and "."
+        token.type = DOT;
+        if (cursor < end && *cursor == '.') {
+            ++cursor;
+            token.length = 2;
+            token.type = DOT2;
+            if (cursor < end && *cursor == '.') {
+                ++cursor;
+                token.length = 3;
+                token.type = DOT3;
+            }
+        }
+        break;
+    default: token.type = UNKNOWN; break;
+    }
+}
+
+bool Rubiee::PrattParser::expect(TokenType type) {
+    if (token.type != type) {
+        error("syntax error");
+        return false;
+    }
+    next();
+    return true;
+}
+
+bool Rubiee::PrattParser::startsExpr() const {
+    return token.type == INT_CONST || token.type == FLOAT_CONST || token.type == IDENTIFIER ||
+           token.type == IF || token.type == CASE || token.type == FOR || 
+           token.type == REQUIRE || token.type == YIELD || token.type == L_PAREN;
+}
+
+// Same precedence levels as the `%left` declarations in `parser.yy`, `0` for
+// tokens which are not binary operators. `DIV` is declared there without a
+// rule, so it is not an operator here either.
+int Rubiee::PrattParser::precedence(TokenType type) {
+    switch (type) {
+    case GREATER_THAN:
+    case LESS_THAN:
+    case EQUAL:
+    case GREATER_THAN_OR_EQUAL:
+    case LESS_THAN_OR_EQUAL:
+        return 1;
+    case PLUS:
+    case MINUS:
+        return 2;
+    case MUL:
+        return 3;
+    default:
+        return 0;
+    }
+}
+
+// def : DEF IDENTIFIER def_paren params R_PAREN exprs END | DEF IDENTIFIER def_paren R_PAREN exprs END,
+// def_paren : L_PAREN | CALL_L_PAREN
+Rubiee::Function *Rubiee::PrattParser::parseDef() {
+    int start_line = token.line;
+    bool memo = token.type == MEMO;
+    if (memo) {
+        next();
+    }
+    if (!expect(DEF) || token.type != IDENTIFIER) {
+        error("syntax error");
+        return nullptr;
+    }
+    std::string name(token.text, token.length);
+    next();
+
+    // params : IDENTIFIER | params COMMA IDENTIFIER
+    std::vector<std::string> params;
+    if (token.type != L_PAREN && token.type != CALL_L_PAREN) {
+        error("syntax error");
+        return nullptr;
+    }
+    next();
+    while (token.type != R_PAREN) {
+        if (token.type != IDENTIFIER) {
+            error("syntax error");
+            return nullptr;
+        }
+        params.push_back(std::string(token.text, token.length));
+        next();
+        if (token.type != COMMA) {
+            break;
+        }
+        next();
+        // No trailing comma
+        if (token.type == R_PAREN) {
+            error("syntax error");
+            return nullptr;
+        }
+    }
+
+    std::vector<Expr*> body_exprs;
+    if (!expect(R_PAREN) || !parseExprs(body_exprs) || !expect(END)) {
+        return nullptr;
+    }
+
+    return located(new Function(
+        located(new FunctionPrototype(std::move(name), std::move(params)), start_line),
+        std::move(body_exprs),
+        memo
+    ), start_line);
+}
+
+Rubiee::Expr *Rubiee::PrattParser::parseExpr(int min_precedence) {
+    Expr *lhs = parsePrimary();
+
+    // expr DOT IDENTIFIER block, `.` binds tighter than any operator
+    while (lhs && token.type == DOT) {
+        lhs = parseMethod(lhs);
+    }
+
+    // All operators are left associative, so the right operand only takes
+    // operators binding tighter than the current one
+    int prec;
+    int lhs_line = lhs ? lhs->line : 0;
+    while (lhs && (prec = precedence(token.type)) > min_precedence) {
+        TokenType op = token.type;
+        next();
+
+        Expr *rhs = parseExpr(prec);
+        if (!rhs) {
+            return nullptr;
+        }
+        lhs = parseBinary(op, lhs, rhs);
+        if (lhs) {
+            lhs->line = lhs_line;
+        }
+    }
+    return lhs;
+}
+
+// expr DOT IDENTIFIER block, where only `times` is defined
+Rubiee::Expr *Rubiee::PrattParser::parseMethod(Expr *receiver) {
+    next();
+    if (token.type != IDENTIFIER) {
+        return error("syntax error");
+    }
+    std::string name(token.text, token.length);
+    if (name != "times") {
+        return error("undefined method `" + name + "`");
+    }
+    next();
+
+    Block *block = parseBlock();
+    if (!block) {
+        return nullptr;
+    }
+    return located(new RangeLoopExpr(located(new IntConst(0), receiver->line), receiver, true, block), receiver->line);
+}
+
+// L_PAREN expr DOT2 expr R_PAREN DOT IDENTIFIER block, and the same with DOT3,
+// where only `each` is defined
+Rubiee::Expr *Rubiee::PrattParser::parseRange() {
+    int start_line = token.line;
+    next();
+
+    Expr *first = parseExpr(0);
+    if (!first) {
+        return nullptr;
+    }
+    if (token.type != DOT2 && token.type != DOT3) {
+        return error("syntax error");
+    }
+    bool exclusive = token.type == DOT3;
+    next();
+
+    Expr *last = parseExpr(0);
+    if (!last || !expect(R_PAREN) || !expect(DOT)) {
+        return nullptr;
+    }
+    if (token.type != IDENTIFIER) {
+        return error("syntax error");
+    }
+    std::string name(token.text, token.length);
+    if (name != "each") {
+        return error("undefined method `" + name + "`");
+    }
+    next();
+
+    Block *block = parseBlock();
+    if (!block) {
+        return nullptr;
+    }
+    return located(new RangeLoopExpr(first, last, exclusive, block), start_line);
+}
+
+// block : DO exprs END | DO PIPE params PIPE exprs END
+Rubiee::Block *Rubiee::PrattParser::parseBlock() {
+    if (!expect(DO)) {
+        return nullptr;
+    }
+
+    std::vector<std::string> params;
+    if (token.type == PIPE) {
+        next();
+        while (true) {
+            if (token.type != IDENTIFIER) {
+                error("syntax error");
+                return nullptr;
+            }
+            params.push_back(std::string(token.text, token.length));
+            next();
+            if (token.type != COMMA) {
+                break;
+            }
+            next();
+        }
+        if (!expect(PIPE)) {
+            return nullptr;
+        }
+    }
+
+    std::vector<Expr*> body_exprs;
+    if (!parseExprs(body_exprs)) {
+        return nullptr;
+    }
+    int end_line = token.line;
+    if (!expect(END)) {
+        return nullptr;
+    }
+    Block *block = new Block(std::move(params), std::move(body_exprs));
+    block->end_line = end_line;
+    return block;
+}
+
+Rubiee::Expr *Rubiee::PrattParser::parseBinary(TokenType op, Expr *lhs, Expr *rhs) {
+    switch (op) {
+    case PLUS: return new BinaryExpr(lhs, rhs, '+');
+    case MINUS: return new BinaryExpr(lhs, rhs, '-');
+    case MUL: return new BinaryExpr(lhs, rhs, '*');
+    case GREATER_THAN_OR_EQUAL: return new ComparisonExpr(lhs, rhs, ">=");
+    case LESS_THAN_OR_EQUAL: return new ComparisonExpr(lhs, rhs, "<=");
+    case GREATER_THAN: return new ComparisonExpr(lhs, rhs, ">");
+    case LESS_THAN: return new ComparisonExpr(lhs, rhs, "<");
+    case EQUAL: return new ComparisonExpr(lhs, rhs, "==");
+    default: return error("syntax error");
+    }
+}
+
+Rubiee::Expr *Rubiee::PrattParser::parsePrimary() {
+    int start_line = token.line;
+
+    switch (token.type) {
+    case INT_CONST: {
+        Expr *expr = located(new IntConst(token.int_const), start_line);
+        next();
+        return expr;
+    }
+
+    case FLOAT_CONST: {
+        Expr *expr = located(new FloatConst(token.float_const), start_line);
+        next();
+        return expr;
+    }
+
+    case IDENTIFIER: {
+        std::string name(token.text, token.length);
+        next();
+
+        // IDENTIFIER CALL_L_PAREN args R_PAREN | IDENTIFIER CALL_L_PAREN R_PAREN,
+        // optionally followed by a block
+        if (token.type == CALL_L_PAREN) {
+            next();
+            std::vector<Expr*> args;
+            if ((token.type != R_PAREN && !parseArgs(args)) || !expect(R_PAREN)) {
+                return nullptr;
+            }
+            Block *block = nullptr;
+            if (token.type == DO && !(block = parseBlock())) {
+                return nullptr;
+            }
+            return located(new FunctionCall(std::move(name), std::move(args), block), start_line);
+        }
+
+        // IDENTIFIER ASSIGNMENT expr
+        if (token.type == ASSIGNMENT) {
+            next();
+            Expr *expr = parseExpr(0);
+            if (!expr) {
+                return nullptr;
+            }
+            return located(new VariableAssignment(located(new Variable(std::move(name)), start_line), expr), start_line);
+        }
+
+        return located(new Variable(std::move(name)), start_line);
+    }
+
+    // IF expr exprs END | IF expr exprs ELSE exprs END
+    case IF: {
+        next();
+        Expr *condition = parseExpr(0);
+        std::vector<Expr*> then_exprs, else_exprs;
+        if (!condition || !parseExprs(then_exprs)) {
+            return nullptr;
+        }
+        if (token.type == ELSE) {
+            next();
+            if (!parseExprs(else_exprs)) {
+                return nullptr;
+            }
+        }
+        if (!expect(END)) {
+            return nullptr;
+        }
+        return located(new IfExpr(condition, std::move(then_exprs), std::move(else_exprs)), start_line);
+    }
+
+    // CASE expr whens END | CASE expr whens ELSE exprs END
+    case CASE: {
+        next();
+        Expr *subject = parseExpr(0);
+        if (!subject) {
+            return nullptr;
+        }
+
+        // whens : when | whens when, when : WHEN args exprs
+        std::vector<WhenClause> whens;
+        do {
+            std::vector<Expr*> values, body_exprs;
+            if (!expect(WHEN) || !parseArgs(values) || !parseExprs(body_exprs)) {
+                return nullptr;
+            }
+            whens.push_back(WhenClause(std::move(values), std::move(body_exprs)));
+        } while (token.type == WHEN);
+
+        std::vector<Expr*> else_exprs;
+        if (token.type == ELSE) {
+            next();
+            if (!parseExprs(else_exprs)) {
+                return nullptr;
+            }
+        }
+        if (!expect(END)) {
+            return nullptr;
+        }
+        return located(new CaseExpr(subject, std::move(whens), std::move(else_exprs)), start_line);
+    }
+
+    // FOR expr SEMICOLON expr SEMICOLON expr exprs END
+    case FOR: {
+        next();
+        Expr *start_expr = parseExpr(0);
+        if (!start_expr || !expect(SEMICOLON)) {
+            return nullptr;
+        }
+        Expr *continue_condition = parseExpr(0);
+        if (!continue_condition || !expect(SEMICOLON)) {
+            return nullptr;
+        }
+        Expr *step_expr = parseExpr(0);
+        std::vector<Expr*> body_exprs;
+        if (!step_expr || !parseExprs(body_exprs)) {
+            return nullptr;
+        }
+        int end_line = token.line;
+        if (!expect(END)) {
+            return nullptr;
+        }
+        ForLoopExpr *loop = located(new ForLoopExpr(start_expr, continue_condition, step_expr, std::move(body_exprs)), start_line);
+        loop->end_line = end_line;
+        return loop;
+    }
+
+    case L_PAREN:
+        return parseRange();
+
+    // YIELD | YIELD CALL_L_PAREN args R_PAREN | YIELD CALL_L_PAREN R_PAREN
+    case YIELD: {
+        next();
+        std::vector<Expr*> args;
+        if (token.type == CALL_L_PAREN) {
+            next();
+            if (!parseArgs(args) || !expect(R_PAREN)) {
+                return nullptr;
+            }
+        }
+        return located(new YieldExpr(std::move(args)), start_line);
+    }
+
+    // REQUIRE STRING_CONST
+    case REQUIRE: {
+        next();
+        if (token.type != STRING_CONST) {
+            return error("syntax error");
+        }
+        Expr *expr = located(new Require(std::string(token.text, token.length)), start_line);
+        next();
+        return expr;
+    }
+
+    default:
+        return error("syntax error");
+    }
+}
+
+// exprs : expr | exprs expr
+bool Rubiee::PrattParser::parseExprs(std::vector<Expr*> &exprs) {
+    do {
+        Expr *expr = parseExpr(0);
+        if (!expr) {
+            return false;
+        }
+        exprs.push_back(expr);
+    } while (startsExpr());
+    return true;
+}
+
+// args : expr | args COMMA expr
+bool Rubiee::PrattParser::parseArgs(std::vector<Expr*> &args) {
+    while (true) {
+        Expr *expr = parseExpr(0);
+        if (!expr) {
+            return false;
+        }
+        args.push_back(expr);
+
+        if (token.type != COMMA) {
+            return true;
+        }
+        next();
+    }
+}
+
+Rubiee::Expr *Rubiee::PrattParser::error(const std::string &err_message) {
+    // Only the first error is reported, as Bison does without error recovery
+    if (!failed) {
+        std::cerr << "Error: " << err_message << "\n";
+        failed = true;
+    }
+    return nullptr;
+}
@@ -0,0 +1,103 @@
+#ifndef __PRATT_PARSER_H__
+#define __PRATT_PARSER_H__ 1
+
+#include <istream>
+#include <string>
+#include <vector>
+#include "ast.h"
+
+namespace Rubiee {
+
+class Driver;
+
+// A hand-written alternative to the Bison parser in `parser.yy`.
+//
+// It accepts the same grammar, builds the same AST and reports errors the same
+// way, but scans the whole source in memory and parses expressions by operator
+// precedence in a single pass, without going through `yylex` for every token.
+class PrattParser {
+public:
+    PrattParser(std::istream &input, Driver &driver);
+
+    // Returns 0 on success, like `Parser::parse`
+    int parse();
+
+private:
+    enum TokenType {
+        END_OF_INPUT,
+        INT_CONST,
+        FLOAT_CONST,
+        IDENTIFIER,
+        STRING_CONST,
+        DEF,
+        MEMO,
+        IF,
+        FOR,
+        ELSE,
+        CASE,
+        WHEN,
+        DO,
+        YIELD,
+        END,
+        REQUIRE,
+        GREATER_THAN_OR_EQUAL,
+        LESS_THAN_OR_EQUAL,
+        GREATER_THAN,
+        LESS_THAN,
+        EQUAL,
+        PLUS,
+        MINUS,
+        MUL,
+        DIV,
+        ASSIGNMENT,
+        COMMA,
+        SEMICOLON,
+        L_PAREN,
+        // `(` after a name or `yield` on the same line, see `CALLEE` in `lexer.l`
+        CALL_L_PAREN,
+        R_PAREN,
+        DOT,
+        DOT2,
+        DOT3,
+        PIPE,
+        UNKNOWN
+    };
+
+    struct Token {
+        TokenType type;
+        const char *text;
+        size_t length;
+        long long int_const;
+        double float_const;
+        int line;
+    };
+
+    Driver &driver;
+    std::string source;
+    const char *cursor;
+    const char *end;
+    int line;
+    Token token;
+    bool failed;
+
+    void next();
+    bool expect(TokenType type);
+    bool startsExpr() const;
+    static int precedence(TokenType type);
+
+    Function *parseDef();
+    Expr *parseExpr(int min_precedence);
+    Expr *parsePrimary();
+    Expr *parseRange();
+    Expr *parseMethod(Expr *receiver);
+    Block *parseBlock();
+    Expr *parseBinary(TokenType op, Expr *lhs, Expr *rhs);
+    bool parseExprs(std::vector<Expr*> &exprs);
+    bool parseArgs(std::vector<Expr*> &args);
+
+    Expr *error(const std::string &err_message);
+};
+
+}
+
+#endif
@@ -0,0 +1,255 @@
+#include <signal.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <set>
+#include <sstream>
+#include "profiler.h"
+
+volatile int _rubiee_profile_line = 0;
+volatile int _rubiee_profile_depth = 0;
+const Rubiee::ProfileFrame *volatile _rubiee_profile_stack[Rubiee::PROFILE_STACK_SIZE + 1];
+
+// The signal handler only touches these, the node table is allocated before
+// the timer starts. Samples which find no room in it are dropped.
+static Rubiee::Profiler::Node *node_table = nullptr;
+static volatile size_t node_table_mask = 0;
+static volatile unsigned long dropped_samples = 0;
+
+static const size_t NODE_TABLE_SIZE = 1 << 16;
+
+// Index of the node for `frame` or `line` under `parent`, added if missing,
+// `-1` if the table is full
+static int findNode(int parent, const Rubiee::ProfileFrame *frame, int line) {
+    size_t slot = (((uintptr_t) frame >> 4) ^ ((size_t) line * 2654435761u) ^ ((size_t) parent * 40503u)) & node_table_mask;
+    for (size_t probe = 0; probe <= node_table_mask; probe++, slot = (slot + 1) & node_table_mask) {
+        Rubiee::Profiler::Node &node = node_table[slot];
+        if (!node.used) {
+            node.used = true;
+            node.parent = parent;
+            node.frame = frame;
+            node.line = line;
+            return slot;
+        }
+        if (node.parent == parent && node.frame == frame && node.line == line) {
+            return slot;
+        }
+    }
+    return -1;
+}
+
+static void onProfileSignal(int) {
+    if (!node_table) {
+        return;
+    }
+
+    int line = _rubiee_profile_line;
+    int depth = std::min((int) _rubiee_profile_depth, Rubiee::PROFILE_STACK_SIZE);
+    int node = -1;
+    for (int i = 0; i < depth; i++) {
+        node = findNode(node, _rubiee_profile_stack[i], 0);
+        if (node < 0) {
+            dropped_samples++;
+            return;
+        }
+    }
+
+    node = findNode(node, nullptr, line);
+    if (node < 0) {
+        dropped_samples++;
+        return;
+    }
+    node_table[node].count++;
+}
+
+Rubiee::Profiler::Profiler(std::string main_path, int interval_us) : main_path(main_path), interval_us(interval_us) {}
+
+void Rubiee::Profiler::addFile(const std::string &path, const std::string &source) {
+    std::vector<std::string> &lines = files[path];
+    std::istringstream input(source);
+    std::string text;
+
+    // Lines are numbered from 1, index 0 collects samples outside of the code
+    lines.push_back("");
+    while (std::getline(input, text)) {
+        lines.push_back(text);
+    }
+}
+
+void Rubiee::Profiler::start() {
+    _rubiee_profile_line = 0;
+    _rubiee_profile_depth = 0;
+    Node empty = { false, -1, nullptr, 0, 0 };
+    nodes.assign(NODE_TABLE_SIZE, empty);
+    node_table_mask = NODE_TABLE_SIZE - 1;
+    dropped_samples = 0;
+    node_table = nodes.data();
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = onProfileSignal;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGPROF, &action, nullptr);
+
+    struct itimerval timer;
+    timer.it_interval.tv_sec = interval_us / 1000000;
+    timer.it_interval.tv_usec = interval_us % 1000000;
+    timer.it_value = timer.it_interval;
+    setitimer(ITIMER_PROF, &timer, nullptr);
+}
+
+void Rubiee::Profiler::stop() {
+    struct itimerval timer;
+    memset(&timer, 0, sizeof(timer));
+    setitimer(ITIMER_PROF, &timer, nullptr);
+    signal(SIGPROF, SIG_DFL);
+
+    node_table = nullptr;
+}
+
+Rubiee::Profiler::Stacks Rubiee::Profiler::collectStacks() const {
+    Stacks stacks;
+    for (auto node = nodes.begin(); node != nodes.end(); ++node) {
+        if (node->count == 0) {
+            continue;
+        }
+
+        std::vector<const ProfileFrame *> frames;
+        for (int parent = node->parent; parent >= 0; parent = nodes[parent].parent) {
+            frames.push_back(nodes[parent].frame);
+        }
+        std::reverse(frames.begin(), frames.end());
+        stacks[std::make_pair(frames, node->line)] += node->count;
+    }
+    return stacks;
+}
+
+std::string Rubiee::Profiler::pathOf(const std::vector<const ProfileFrame *> &frames) const {
+    return frames.empty() ? main_path : frames.back()->path;
+}
+
+std::string Rubiee::Profiler::sourceLine(const std::string &path, int line) const {
+    auto file = files.find(path);
+    if (file == files.end() || line <= 0 || line >= (int) file->second.size()) {
+        return "<outside of script>";
+    }
+
+    std::string text = file->second[line];
+    size_t first = text.find_first_not_of(" \t");
+    return first == std::string::npos ? "" : text.substr(first);
+}
+
+std::string Rubiee::Profiler::lineName(const std::string &path, int line) const {
+    return path == main_path ? std::to_string(line) : path + ":" + std::to_string(line);
+}
+
+void Rubiee::Profiler::report(std::ostream &out) const {
+    const unsigned TOP = 10;
+    Stacks stacks = collectStacks();
+    unsigned long total = 0;
+    for (auto stack = stacks.begin(); stack != stacks.end(); ++stack) {
+        total += stack->second;
+    }
+
+    out << "Profile: " << total << " samples, every " << interval_us << " us";
+    if (dropped_samples) {
+        out << ", " << dropped_samples << " dropped";
+    }
+    out << "\n";
+    if (total == 0) {
+        return;
+    }
+
+    // A sample counts once for every loop on its stack, however often the
+    // loop is on it
+    std::map<std::pair<std::string, int>, unsigned long> line_samples;
+    std::map<std::pair<std::string, std::pair<int, int>>, unsigned long> loop_samples;
+    for (auto stack = stacks.begin(); stack != stacks.end(); ++stack) {
+        const std::vector<const ProfileFrame *> &frames = stack->first.first;
+        line_samples[std::make_pair(pathOf(frames), stack->first.second)] += stack->second;
+
+        std::set<std::pair<std::string, std::pair<int, int>>> loops;
+        for (auto frame = frames.begin(); frame != frames.end(); ++frame) {
+            if ((*frame)->end_line > 0) {
+                loops.insert(std::make_pair(std::string((*frame)->path), std::make_pair((*frame)->start_line, (*frame)->end_line)));
+            }
+        }
+        for (auto loop = loops.begin(); loop != loops.end(); ++loop) {
+            loop_samples[*loop] += stack->second;
+        }
+    }
+
+    std::vector<std::pair<unsigned long, std::pair<std::string, int>>> hot_lines;
+    for (auto line = line_samples.begin(); line != line_samples.end(); ++line) {
+        hot_lines.push_back(std::make_pair(line->second, line->first));
+    }
+    std::sort(hot_lines.rbegin(), hot_lines.rend());
+
+    std::vector<std::pair<unsigned long, std::pair<std::string, std::pair<int, int>>>> hot_loops;
+    for (auto loop = loop_samples.begin(); loop != loop_samples.end(); ++loop) {
+        hot_loops.push_back(std::make_pair(loop->second, loop->first));
+    }
+    std::sort(hot_loops.rbegin(), hot_loops.rend());
+
+    out << std::fixed << std::setprecision(1);
+
+    out << "\nHot lines:\n";
+    out << std::setw(10) << "samples" << std::setw(8) << "%" << std::setw(8) << "line" << "  source\n";
+    for (unsigned i = 0; i < hot_lines.size() && i < TOP; i++) {
+        const std::string &path = hot_lines[i].second.first;
+        int line = hot_lines[i].second.second;
+        out << std::setw(10) << hot_lines[i].first
+            << std::setw(7) << 100.0 * hot_lines[i].first / total << "%"
+            << " " << std::setw(7) << lineName(path, line)
+            << "  " << sourceLine(path, line) << "\n";
+    }
+
+    if (hot_loops.empty()) {
+        return;
+    }
+
+    out << "\nHot loops:\n";
+    out << std::setw(10) << "samples" << std::setw(8) << "%" << std::setw(12) << "lines" << "  source\n";
+    for (unsigned i = 0; i < hot_loops.size() && i < TOP; i++) {
+        const std::string &path = hot_loops[i].second.first;
+        std::pair<int, int> lines = hot_loops[i].second.second;
+        out << std::setw(10) << hot_loops[i].first
+            << std::setw(7) << 100.0 * hot_loops[i].first / total << "%"
+            << " " << std::setw(11) << lineName(path, lines.first) + "-" + std::to_string(lines.second)
+            << "  " << sourceLine(path, lines.first) << "\n";
+    }
+}
+
+bool Rubiee::Profiler::writeCollapsedStacks(const std::string &path) const {
+    std::ofstream out(path.c_str());
+    if (!out) {
+        return false;
+    }
+
+    // main;for@2;for@4;line 5 <samples>, with every frame the sample was
+    // taken in. Frames emitted by different modules may have the same name,
+    // so stacks are merged by their text.
+    std::map<std::string, unsigned long> collapsed;
+    Stacks stacks = collectStacks();
+    for (auto stack = stacks.begin(); stack != stacks.end(); ++stack) {
+        std::string text = "main";
+        const std::vector<const ProfileFrame *> &frames = stack->first.first;
+        for (auto frame = frames.begin(); frame != frames.end(); ++frame) {
+            text += ";" + std::string((*frame)->name);
+        }
+        if (stack->first.second > 0) {
+            text += ";line " + std::to_string(stack->first.second);
+        }
+        collapsed[text] += stack->second;
+    }
+
+    for (auto stack = collapsed.begin(); stack != collapsed.end(); ++stack) {
+        out << stack->first << " " << stack->second << "\n";
+    }
+    return true;
+}
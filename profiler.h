@@ -0,0 +1,93 @@
+#ifndef __PROFILER_H__
+#define __PROFILER_H__ 1
+
+#include <map>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Rubiee {
+
+// A frame of the shadow call stack kept by code compiled for profiling, such
+// as a function or a loop. Codegen emits a constant of this layout for every
+// frame.
+struct ProfileFrame {
+    // File the code of the frame is in
+    const char *path;
+    // Name of the frame in collapsed stacks, e.g. `for@3`
+    const char *name;
+    // Lines of a loop, `0` for other frames
+    int start_line, end_line;
+};
+
+// Frames deeper than this are not recorded
+const int PROFILE_STACK_SIZE = 256;
+
+}
+
+// Source line currently executed by JIT-compiled code, and the shadow call
+// stack it is executed in. Entering a frame stores it at
+// `_rubiee_profile_stack[_rubiee_profile_depth]`, or at the last slot once the
+// stack is full, and increments the depth. Leaving it restores the depth. Only
+// updated by code compiled with profiling enabled.
+extern "C" volatile int _rubiee_profile_line;
+extern "C" volatile int _rubiee_profile_depth;
+extern "C" const Rubiee::ProfileFrame *volatile _rubiee_profile_stack[Rubiee::PROFILE_STACK_SIZE + 1];
+
+namespace Rubiee {
+
+// A sampling profiler for JIT-compiled scripts.
+//
+// While the profiler runs, a SIGPROF timer samples the line and the shadow
+// call stack of profiled code into a calling context tree, so every sample
+// keeps the frames it was taken in. Reports attribute samples to lines and
+// to every loop on their stack.
+class Profiler {
+public:
+    // `main_path` is the script run, samples outside of any frame go to it
+    Profiler(std::string main_path, int interval_us = 1000);
+
+    // Register the source of a file whose code is profiled
+    void addFile(const std::string &path, const std::string &source);
+
+    void start();
+    void stop();
+
+    // Print the hottest lines and loops, with their source text
+    void report(std::ostream &out) const;
+    // Write samples in the collapsed stack format used by flame graph tools
+    bool writeCollapsedStacks(const std::string &path) const;
+
+    // A node of the calling context tree filled by the signal handler: a
+    // frame called from its parent node, or a line sampled in its parent
+    // node, with a null frame
+    struct Node {
+        bool used;
+        int parent;
+        const ProfileFrame *frame;
+        int line;
+        unsigned long count;
+    };
+
+private:
+    // Frames from the outermost one and the line of sampled nodes, with
+    // their samples
+    typedef std::map<std::pair<std::vector<const ProfileFrame *>, int>, unsigned long> Stacks;
+
+    std::string main_path;
+    std::map<std::string, std::vector<std::string>> files;
+    std::vector<Node> nodes;
+    int interval_us;
+
+    Stacks collectStacks() const;
+    // File the innermost frame of `frames` is in
+    std::string pathOf(const std::vector<const ProfileFrame *> &frames) const;
+    std::string sourceLine(const std::string &path, int line) const;
+    // Line `line` of `path`, with the file unless it is the main script
+    std::string lineName(const std::string &path, int line) const;
+};
+
+}
+
+#endif
@@ -0,0 +1,105 @@
+#ifndef __PROTOCOL_H__
+#define __PROTOCOL_H__ 1
+
+#include <stdint.h>
+#include <string>
+#include <unistd.h>
+#include <errno.h>
+
+// Wire format shared by the compile server and `rubiee-client`.
+//
+// Both sides send frames, each made of a one-byte frame type, a 4-byte
+// big-endian payload length and the payload. The client sends an `OPTION`
+// frame for every option of `main` to run the script with, e.g. `--pratt`,
+// the absolute path of the script in a `PATH` frame, then the script in a
+// `SCRIPT` frame, and shuts down its writing side. The server answers with
+// `OUTPUT`, `ERROR` and `STATS` frames. The last frame is always `EXIT`,
+// whose payload is the 4-byte exit status.
+
+namespace Rubiee {
+namespace Protocol {
+
+// Sent by the client
+const char OPTION = 'A';
+// Reports and profiles name the script after it
+const char PATH = 'P';
+const char SCRIPT = 'C';
+
+const char OUTPUT = 'O';
+const char ERROR = 'E';
+const char STATS = 'S';
+const char EXIT = 'X';
+
+inline bool writeAll(int fd, const char *data, size_t size) {
+    while (size > 0) {
+        ssize_t n = write(fd, data, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+inline bool readAll(int fd, char *data, size_t size) {
+    while (size > 0) {
+        ssize_t n = read(fd, data, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+inline bool writeFrame(int fd, char type, const char *payload, uint32_t size) {
+    char header[5] = {
+        type,
+        (char) (size >> 24), (char) (size >> 16), (char) (size >> 8), (char) size
+    };
+    return writeAll(fd, header, sizeof(header)) && writeAll(fd, payload, size);
+}
+
+inline bool writeFrame(int fd, char type, const std::string &payload) {
+    return writeFrame(fd, type, payload.data(), payload.size());
+}
+
+inline bool readFrame(int fd, char &type, std::string &payload) {
+    unsigned char header[5];
+    if (!readAll(fd, (char *) header, sizeof(header))) {
+        return false;
+    }
+
+    type = header[0];
+    uint32_t size = ((uint32_t) header[1] << 24) | ((uint32_t) header[2] << 16) |
+                    ((uint32_t) header[3] << 8) | (uint32_t) header[4];
+    payload.resize(size);
+    return size == 0 || readAll(fd, &payload[0], size);
+}
+
+inline std::string encodeStatus(int status) {
+    uint32_t s = (uint32_t) status;
+    return std::string({ (char) (s >> 24), (char) (s >> 16), (char) (s >> 8), (char) s });
+}
+
+inline int decodeStatus(const std::string &payload) {
+    if (payload.size() != 4) {
+        return 1;
+    }
+    const unsigned char *p = (const unsigned char *) payload.data();
+    return (int) (((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) |
+                  ((uint32_t) p[2] << 8) | (uint32_t) p[3]);
+}
+
+}
+}
+
+#endif
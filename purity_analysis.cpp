@@ -0,0 +1,182 @@
+#include <stdio.h>
+#include "purity_analysis.h"
+
+Rubiee::PurityAnalysis::PurityAnalysis() : current(nullptr) {}
+
+const std::set<std::string> &Rubiee::PurityAnalysis::memoizable() const {
+    return memoizable_functions;
+}
+
+const std::set<std::string> &Rubiee::PurityAnalysis::pure() const {
+    return pure_functions;
+}
+
+void Rubiee::PurityAnalysis::setPureHostFunctions(std::set<std::string> names) {
+    pure_host_functions = names;
+}
+
+void Rubiee::PurityAnalysis::analyze(std::vector<ASTNode*> &nodes, const std::set<std::string> &pure_imports) {
+    // Collect callees first, functions can be called before their definition
+    for (unsigned i = 0; i < nodes.size(); i++) {
+        if (Function *function = dynamic_cast<Function *>(nodes[i])) {
+            FunctionInfo info = { std::set<std::string>(), false, function->memo };
+            functions[function->proto->name] = info;
+        }
+    }
+    for (unsigned i = 0; i < nodes.size(); i++) {
+        nodes[i]->accept(*this);
+    }
+
+    // Calling anything else than a user function or a pure host function is a
+    // side effect
+    for (auto function = functions.begin(); function != functions.end(); ++function) {
+        for (auto callee = function->second.callees.begin(); callee != function->second.callees.end(); ++callee) {
+            if (functions.find(*callee) == functions.end() && pure_imports.count(*callee) == 0 &&
+                pure_host_functions.count(*callee) == 0) {
+                function->second.has_side_effects = true;
+            }
+        }
+    }
+
+    // Side effects spread to callers until nothing changes
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (auto function = functions.begin(); function != functions.end(); ++function) {
+            if (function->second.has_side_effects) {
+                continue;
+            }
+            for (auto callee = function->second.callees.begin(); callee != function->second.callees.end(); ++callee) {
+                auto info = functions.find(*callee);
+                if (info != functions.end() && info->second.has_side_effects) {
+                    function->second.has_side_effects = true;
+                    changed = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    for (auto function = functions.begin(); function != functions.end(); ++function) {
+        const std::string &name = function->first;
+        if (function->second.has_side_effects) {
+            if (function->second.memo) {
+                fprintf(stderr, "Function `%s` has side effects, it is not memoized.\n", name.c_str());
+            }
+            continue;
+        }
+        pure_functions.insert(name);
+        if (function->second.memo || isRecursive(name)) {
+            memoizable_functions.insert(name);
+        }
+    }
+}
+
+bool Rubiee::PurityAnalysis::isRecursive(const std::string &name) {
+    std::set<std::string> visited;
+    std::vector<std::string> pending(functions[name].callees.begin(), functions[name].callees.end());
+
+    while (!pending.empty()) {
+        std::string callee = pending.back();
+        pending.pop_back();
+        if (callee == name) {
+            return true;
+        }
+        auto info = functions.find(callee);
+        if (!visited.insert(callee).second || info == functions.end()) {
+            continue;
+        }
+        pending.insert(pending.end(), info->second.callees.begin(), info->second.callees.end());
+    }
+    return false;
+}
+
+void Rubiee::PurityAnalysis::visitAll(std::vector<Expr*> &exprs) {
+    for (auto expr = exprs.begin(); expr != exprs.end(); ++expr) {
+        (*expr)->accept(*this);
+    }
+}
+
+void Rubiee::PurityAnalysis::visit(Expr &expr) {}
+void Rubiee::PurityAnalysis::visit(Statement &stmt) {}
+void Rubiee::PurityAnalysis::visit(IntConst &int_const) {}
+void Rubiee::PurityAnalysis::visit(FloatConst &float_const) {}
+void Rubiee::PurityAnalysis::visit(Variable &var) {}
+void Rubiee::PurityAnalysis::visit(FunctionPrototype &function_prototype) {}
+
+void Rubiee::PurityAnalysis::visit(BinaryExpr &binary_expr) {
+    binary_expr.leftOperand->accept(*this);
+    binary_expr.rightOperand->accept(*this);
+}
+
+void Rubiee::PurityAnalysis::visit(ComparisonExpr &comparison_expr) {
+    comparison_expr.leftOperand->accept(*this);
+    comparison_expr.rightOperand->accept(*this);
+}
+
+void Rubiee::PurityAnalysis::visit(IfExpr &if_expr) {
+    if_expr.condition->accept(*this);
+    visitAll(if_expr.then_exprs);
+    visitAll(if_expr.else_exprs);
+}
+
+void Rubiee::PurityAnalysis::visit(CaseExpr &case_expr) {
+    case_expr.subject->accept(*this);
+    for (auto when = case_expr.whens.begin(); when != case_expr.whens.end(); ++when) {
+        visitAll(when->values);
+        visitAll(when->body_exprs);
+    }
+    visitAll(case_expr.else_exprs);
+}
+
+void Rubiee::PurityAnalysis::visit(ForLoopExpr &for_loop_expr) {
+    for_loop_expr.start_expr->accept(*this);
+    for_loop_expr.continue_condition->accept(*this);
+    for_loop_expr.step_expr->accept(*this);
+    visitAll(for_loop_expr.body_exprs);
+}
+
+void Rubiee::PurityAnalysis::visit(RangeLoopExpr &range_loop_expr) {
+    range_loop_expr.first->accept(*this);
+    range_loop_expr.last->accept(*this);
+    visitAll(range_loop_expr.block->body_exprs);
+}
+
+// The result of a function which yields depends on the block it is given
+void Rubiee::PurityAnalysis::visit(YieldExpr &yield_expr) {
+    if (current) {
+        current->has_side_effects = true;
+    }
+    visitAll(yield_expr.args);
+}
+
+void Rubiee::PurityAnalysis::visit(VariableAssignment &var_assignment) {
+    var_assignment.expr->accept(*this);
+}
+
+void Rubiee::PurityAnalysis::visit(FunctionCall &function_call) {
+    if (current) {
+        current->callees.insert(function_call.callee);
+    }
+    visitAll(function_call.args);
+    // Blocks are inlined into the caller, see `CodeGenVisitor::generateInlineCall`
+    if (function_call.block) {
+        visitAll(function_call.block->body_exprs);
+    }
+}
+
+void Rubiee::PurityAnalysis::visit(Require &require) {
+    if (current) {
+        current->has_side_effects = true;
+    }
+}
+
+void Rubiee::PurityAnalysis::visit(TopLevelExpr &top_level_expr) {
+    top_level_expr.expr->accept(*this);
+}
+
+void Rubiee::PurityAnalysis::visit(Function &function) {
+    current = &functions[function.proto->name];
+    visitAll(function.body_exprs);
+    current = nullptr;
+}
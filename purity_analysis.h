@@ -0,0 +1,73 @@
+#ifndef __PURITY_ANALYSIS_H__
+#define __PURITY_ANALYSIS_H__ 1
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include "ast.h"
+#include "ast_visitor.h"
+
+namespace Rubiee {
+
+// Finds the functions whose results can be cached.
+//
+// Functions cannot see variables outside of their body, so the only way for
+// them to have side effects is to call a builtin such as `puts` or a host
+// function which is not pure, to require a file, to `yield` to a block, or to
+// call another function which has side effects. Pure functions declared with
+// `memo`, and pure functions which are recursive, are memoized.
+class PurityAnalysis : public ASTNodeVisitor {
+
+public:
+    PurityAnalysis();
+
+    // Host functions registered as pure, see `BUILTIN_PURE`
+    void setPureHostFunctions(std::set<std::string> names);
+    // `pure_imports` are the pure functions of required files. Calling any
+    // other function which `nodes` do not define, except for a pure host
+    // function, is a side effect
+    void analyze(std::vector<ASTNode*> &nodes, const std::set<std::string> &pure_imports);
+    const std::set<std::string> &memoizable() const;
+    // Functions defined by `nodes` which have no side effects
+    const std::set<std::string> &pure() const;
+
+    void visit(Expr &expr);
+    void visit(Statement &stmt);
+    void visit(IntConst &int_const);
+    void visit(FloatConst &float_const);
+    void visit(BinaryExpr &binary_expr);
+    void visit(ComparisonExpr &comparison_expr);
+    void visit(IfExpr &if_expr);
+    void visit(CaseExpr &case_expr);
+    void visit(ForLoopExpr &for_loop_expr);
+    void visit(RangeLoopExpr &range_loop_expr);
+    void visit(YieldExpr &yield_expr);
+    void visit(Variable &var);
+    void visit(VariableAssignment &var_assignment);
+    void visit(FunctionCall &function_call);
+    void visit(Require &require);
+    void visit(FunctionPrototype &function_prototype);
+    void visit(TopLevelExpr &top_level_expr);
+    void visit(Function &function);
+
+private:
+    struct FunctionInfo {
+        std::set<std::string> callees;
+        bool has_side_effects;
+        bool memo;
+    };
+
+    std::map<std::string, FunctionInfo> functions;
+    FunctionInfo *current;
+    std::set<std::string> memoizable_functions;
+    std::set<std::string> pure_functions;
+    std::set<std::string> pure_host_functions;
+
+    void visitAll(std::vector<Expr*> &exprs);
+    bool isRecursive(const std::string &name);
+};
+
+}
+
+#endif
@@ -0,0 +1,138 @@
+#include <stdio.h>
+#include <set>
+#include <sstream>
+#include "rubiee.h"
+#include "codegen_visitor.h"
+#include "purity_analysis.h"
+#include "runtime.h"
+
+struct Rubiee::Script::Code {
+    std::shared_ptr<llvm::orc::KaleidoscopeJIT> jit;
+    llvm::orc::KaleidoscopeJIT::ModuleHandleT module;
+    // Memo caches registered with `_bignum_keep`
+    std::vector<const void *> memo_caches;
+};
+
+Rubiee::Script::Script() : main_fn(nullptr) {}
+
+Rubiee::Script::~Script() {
+    for (auto cache = code->memo_caches.begin(); cache != code->memo_caches.end(); ++cache) {
+        _bignum_forget(*cache);
+    }
+    code->jit->removeModule(code->module);
+}
+
+void Rubiee::Script::run() {
+    main_fn();
+}
+
+void *Rubiee::Script::address(const EntryPoint &entry) const {
+    auto compiled = entries.find(entry.name);
+    if (compiled == entries.end()) {
+        fprintf(stderr, "Function `%s` is not an entry point.\n", entry.name.c_str());
+        return nullptr;
+    }
+    if (compiled->second.entry.return_type != entry.return_type ||
+        compiled->second.entry.arg_types != entry.arg_types) {
+        fprintf(stderr, "Function `%s` is an entry point of another type.\n", entry.name.c_str());
+        return nullptr;
+    }
+    return compiled->second.address;
+}
+
+Rubiee::Engine::Engine() : front_end(Driver::BISON), overflow_checks(true), jit(CodeGenVisitor::createJIT()) {}
+
+void Rubiee::Engine::set_front_end(Driver::FrontEnd f) {
+    front_end = f;
+}
+
+void Rubiee::Engine::set_overflow_checks(bool checks) {
+    overflow_checks = checks;
+}
+
+bool Rubiee::Engine::registerFunction(const std::string &name, void *address, NumericType return_type,
+                                      std::vector<NumericType> arg_types, unsigned flags) {
+    bool taken = findBuiltin(name) != nullptr;
+    for (auto function = host_functions.begin(); function != host_functions.end(); ++function) {
+        taken = taken || function->name == name;
+    }
+    if (taken) {
+        fprintf(stderr, "Function `%s` is already defined.\n", name.c_str());
+        return false;
+    }
+
+    Builtin function = { name, "__rubiee_host_" + name, return_type, arg_types, false, address, flags };
+    host_functions.push_back(function);
+    CodeGenVisitor::bindSymbol(*jit, function.symbol, address);
+    return true;
+}
+
+void Rubiee::Engine::keepBignums(const void *memory, size_t bytes) {
+    _bignum_keep(memory, bytes);
+}
+
+void Rubiee::Engine::forgetBignums(const void *memory) {
+    _bignum_forget(memory);
+}
+
+std::unique_ptr<Rubiee::Script> Rubiee::Engine::compile(const std::string &source,
+                                                        const std::vector<EntryPoint> &entries) {
+    std::istringstream input(source);
+    Driver driver;
+    driver.set_front_end(front_end);
+    std::unique_ptr<std::vector<ASTNode*>> nodes(driver.parseNodes(input));
+    if (!nodes) {
+        return nullptr;
+    }
+
+    std::unique_ptr<CodeGenVisitor> codegen(new CodeGenVisitor(jit));
+    std::set<std::string> pure_functions;
+    for (auto function = host_functions.begin(); function != host_functions.end(); ++function) {
+        codegen->addHostFunction(*function);
+        if (function->flags & BUILTIN_PURE) {
+            pure_functions.insert(function->name);
+        }
+    }
+    for (auto entry = entries.begin(); entry != entries.end(); ++entry) {
+        codegen->addEntry(entry->name, entry->return_type, entry->arg_types);
+    }
+
+    PurityAnalysis purity;
+    purity.setPureHostFunctions(pure_functions);
+    purity.analyze(*nodes, std::set<std::string>());
+    codegen->setMemoization(purity.memoizable(), CodeGenVisitor::DEFAULT_MEMO_CACHE_SIZE, false);
+    codegen->setOverflowChecks(overflow_checks);
+
+    codegen->declareFunctions(*nodes);
+    bool generated = codegen->generateEntries();
+    if (generated) {
+        for (unsigned i = 0; i < nodes->size(); i++) {
+            ((*nodes)[i])->accept(*codegen);
+        }
+    }
+    for (unsigned i = 0; i < nodes->size(); i++) {
+        delete (*nodes)[i];
+    }
+    if (!generated) {
+        return nullptr;
+    }
+
+    // The module just added is searched first, so entry points and caches are
+    // those of the script. Entry points are looked up once, the host calls
+    // them directly.
+    std::unique_ptr<Script> script(new Script());
+    script->main_fn = codegen->compileCode();
+    script->code.reset(new Script::Code());
+    script->code->jit = jit;
+    script->code->module = codegen->moduleHandle();
+    const std::vector<std::string> &caches = codegen->memoCaches();
+    for (auto cache = caches.begin(); cache != caches.end(); ++cache) {
+        script->code->memo_caches.push_back((const void *) (intptr_t) jit->findSymbol(*cache).getAddress());
+    }
+    for (auto entry = entries.begin(); entry != entries.end(); ++entry) {
+        auto symbol = jit->findSymbol(CodeGenVisitor::entryName(entry->name));
+        Script::CompiledEntry compiled = { *entry, (void *) (intptr_t) symbol.getAddress() };
+        script->entries[entry->name] = compiled;
+    }
+    return script;
+}
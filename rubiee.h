@@ -0,0 +1,134 @@
+#ifndef __RUBIEE_H__
+#define __RUBIEE_H__ 1
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "builtins.h"
+#include "driver.h"
+
+// API for embedding Rubiee in a host program, built as `librubiee.a`.
+//
+//   Rubiee::Engine engine;
+//   engine.registerFunction("price", &price, Rubiee::BUILTIN_PURE);
+//   auto script = engine.compile(source, { Rubiee::Engine::entry<double(int, double)>("score") });
+//   auto score = script->function<double(int, double)>("score");
+//   for (...) total += score(id, weight);
+//
+// Numbers cross the boundary as `int` for `INT32`, `long long` for `INT64` and
+// `double` for `DOUBLE`. A `long long` below `RUBIEE_FIXNUM_MIN` is the handle
+// of a bignum, see `runtime.h`, so integers passed in by the host must be at
+// least `RUBIEE_FIXNUM_MIN`, lower ones are reported as unknown bignums.
+
+namespace llvm {
+namespace orc {
+class KaleidoscopeJIT;
+}
+}
+
+namespace Rubiee {
+
+// Native type of a numeric type, only `int`, `long long` and `double` have one
+template <typename T> struct NativeType;
+template <> struct NativeType<int> { static NumericType type() { return INT32; } };
+template <> struct NativeType<long long> { static NumericType type() { return INT64; } };
+template <> struct NativeType<double> { static NumericType type() { return DOUBLE; } };
+
+// A function of a script the host can call, with the types it is called with
+struct EntryPoint {
+    std::string name;
+    NumericType return_type;
+    std::vector<NumericType> arg_types;
+};
+
+template <typename Signature> struct SignatureOf;
+template <typename R, typename... Args> struct SignatureOf<R(Args...)> {
+    static EntryPoint entry(const std::string &name) {
+        EntryPoint entry = { name, NativeType<R>::type(), { NativeType<Args>::type()... } };
+        return entry;
+    }
+};
+
+// A compiled script. Its top level and its entry points can be called any
+// number of times without compiling it again. Scripts share the runtime, e.g.
+// hash tables, which is not thread-safe. Destroying a script frees its code and
+// its memo caches, it can outlive its engine.
+class Script {
+public:
+    ~Script();
+
+    // Run the top level expressions
+    void run();
+
+    // Entry point `name`, `nullptr` if the script was not compiled with it for
+    // `Signature`. Look it up once, calling it is a direct call.
+    template <typename Signature> Signature *function(const std::string &name) const {
+        return reinterpret_cast<Signature *>(address(SignatureOf<Signature>::entry(name)));
+    }
+
+private:
+    friend class Engine;
+
+    struct CompiledEntry {
+        EntryPoint entry;
+        void *address;
+    };
+
+    // The module of the script in the JIT of its engine
+    struct Code;
+    std::unique_ptr<Code> code;
+    void (*main_fn)();
+    std::map<std::string, CompiledEntry> entries;
+
+    Script();
+    void *address(const EntryPoint &entry) const;
+};
+
+// Compiles scripts which can call the functions registered by the host. The
+// native target and the JIT are set up once, by the engine, and every script
+// it compiles is added to the same JIT.
+class Engine {
+public:
+    Engine();
+
+    void set_front_end(Driver::FrontEnd f);
+    void set_overflow_checks(bool checks);
+
+    // Let scripts call `address` as `name`, see `BuiltinFlags` for `flags`.
+    // Returns false if `name` is taken by another builtin or host function.
+    bool registerFunction(const std::string &name, void *address, NumericType return_type,
+                          std::vector<NumericType> arg_types, unsigned flags = 0);
+    template <typename R, typename... Args>
+    bool registerFunction(const std::string &name, R (*fn)(Args...), unsigned flags = 0) {
+        return registerFunction(name, reinterpret_cast<void *>(fn), NativeType<R>::type(),
+                                { NativeType<Args>::type()... }, flags);
+    }
+
+    // Entry point of the function `name`, called as `Signature`
+    template <typename Signature> static EntryPoint entry(const std::string &name) {
+        return SignatureOf<Signature>::entry(name);
+    }
+
+    // Parse and compile `source` with `entries`, reporting errors on stderr.
+    // Returns nullptr on errors. Scripts cannot `require` files. The AST is
+    // freed once the code is generated.
+    std::unique_ptr<Script> compile(const std::string &source,
+                                    const std::vector<EntryPoint> &entries = std::vector<EntryPoint>());
+
+    // Let the `bytes` bytes at `memory` keep the bignums whose handles they
+    // hold, e.g. results of scripts the host stores, from being collected
+    // while scripts run, until `forgetBignums(memory)`
+    static void keepBignums(const void *memory, size_t bytes);
+    static void forgetBignums(const void *memory);
+
+private:
+    Driver::FrontEnd front_end;
+    bool overflow_checks;
+    std::vector<Builtin> host_functions;
+    std::shared_ptr<llvm::orc::KaleidoscopeJIT> jit;
+};
+
+}
+
+#endif
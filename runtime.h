@@ -0,0 +1,103 @@
+#ifndef __RUNTIME_H__
+#define __RUNTIME_H__ 1
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+// Runtime functions called by JIT-compiled code. The JIT binds their symbols
+// to their addresses, see `CodeGenVisitor::bindRuntimeSymbols`, so they must
+// keep C linkage.
+
+extern "C" {
+
+// Every argument of `_puts` is passed as its type, then its value as a
+// `long long` or a `double`. A `PUTS_INT` may be a bignum, a `PUTS_FIXNUM`,
+// passed with `--wrapping-integers`, is always a plain 64-bit integer.
+enum PutsArgType { PUTS_INT = 0, PUTS_DOUBLE = 1, PUTS_FIXNUM = 2 };
+void _puts(int num, ...);
+
+// Integer input. Stream `0` is stdin, stream `n` is the n-th data file
+// registered with `Rubiee::setInputFiles`.
+int _read_int(int stream);
+int _has_int(int stream);
+int _read_ints(int stream);
+
+int _array_size(int array);
+int _array_get(int array, int index);
+// Release an array, its handle may be returned by a later `_read_ints`
+int _array_free(int array);
+
+// Hash tables from integers to integers. A table is a handle returned by
+// `_hash_new`, and entries are visited by position: `_hash_next(table, 0)` is
+// the position of the first entry, `0` once there are none left.
+int _hash_new(long long capacity);
+long long _hash_get(int table, long long key);
+int _hash_has(int table, long long key);
+long long _hash_set(int table, long long key, long long value);
+int _hash_delete(int table, long long key);
+long long _hash_size(int table);
+long long _hash_next(int table, long long position);
+long long _hash_key(int table, long long position);
+long long _hash_value(int table, long long position);
+int _hash_stats(int table);
+// Release a table, its handle may be returned by a later `_hash_new`
+int _hash_free(int table);
+
+// Layout of a hash table, generated code reads the first three members to
+// inline lookups. Slots are in groups of `HASH_GROUP_SIZE`, and a slot has a
+// control byte which is `HASH_EMPTY`, `HASH_DELETED`, or the low 7 bits of
+// the hash of its key. The key of slot `i` is `slots[2 * i]`, its value
+// `slots[2 * i + 1]`.
+enum { HASH_GROUP_SIZE = 16, HASH_EMPTY = -128, HASH_DELETED = -2 };
+struct HashTable {
+    int8_t *ctrl;
+    long long *slots;
+    unsigned long long group_mask;
+    long long size;
+    long long tombstones;
+};
+
+// All hash tables, indexed by handle, freed ones are `nullptr`
+extern HashTable **_rubiee_hash_tables;
+extern int _rubiee_hash_count;
+
+// Arbitrary precision integers. Integers from `RUBIEE_FIXNUM_MIN` up are
+// plain 64-bit values, integers below are handles of bignums. Generated code
+// calls these on overflow, or when an operand is a handle.
+#define RUBIEE_FIXNUM_MIN (INT64_MIN + (1LL << 32))
+long long _bignum_add(long long a, long long b);
+long long _bignum_sub(long long a, long long b);
+long long _bignum_mul(long long a, long long b);
+// `-1`, `0` or `1`
+int _bignum_compare(long long a, long long b);
+double _bignum_to_double(long long a);
+// Integer part of `a`, `0` for NaN
+long long _bignum_from_double(double a);
+// Let `bytes` bytes of memory at `memory` keep the bignums whose handles
+// they hold from being collected. Generated code calls this when it stores a
+// bignum in a memo cache.
+void _bignum_keep(const void *memory, long long bytes);
+// Stop scanning memory registered with `_bignum_keep`, before freeing it
+void _bignum_forget(const void *memory);
+// Reports a range with a bignum bound, whose loop is skipped
+void _bignum_range_error();
+
+}
+
+namespace Rubiee {
+
+void setInputFiles(std::vector<std::string> files);
+
+// Print the load factor and probe lengths of every hash table
+void reportHashStats(FILE *out);
+
+// Shortest text that reads back as `value`, always with a `.` like Ruby
+std::string formatDouble(double value);
+// Decimal digits of an integer, which may be a bignum
+std::string formatInteger(long long value);
+
+}
+
+#endif
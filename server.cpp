@@ -0,0 +1,271 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <sstream>
+#include "server.h"
+#include "protocol.h"
+#include "driver.h"
+#include "codegen_visitor.h"
+
+Rubiee::Server::Server(std::string socket_path, unsigned timeout_seconds) 
+                       : socket_path(socket_path), timeout_seconds(timeout_seconds), listen_fd(-1) {}
+
+Rubiee::Server::~Server() {
+    if (listen_fd >= 0) {
+        close(listen_fd);
+        unlink(socket_path.c_str());
+    }
+}
+
+bool Rubiee::Server::listen() {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+
+    if (socket_path.size() >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Socket path `%s` is too long.\n", socket_path.c_str());
+        return false;
+    }
+    strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        perror("socket");
+        return false;
+    }
+
+    // A stale socket file is left behind if a previous server was killed
+    unlink(socket_path.c_str());
+
+    if (bind(listen_fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+        perror("bind");
+        return false;
+    }
+    if (::listen(listen_fd, SOMAXCONN) < 0) {
+        perror("listen");
+        return false;
+    }
+    return true;
+}
+
+int Rubiee::Server::run() {
+    // Pay the start-up cost once, every script inherits the initialized JIT
+    jit = CodeGenVisitor::createJIT();
+
+    if (!listen()) {
+        return 1;
+    }
+
+    // Reap session processes automatically and survive clients that go away
+    signal(SIGCHLD, SIG_IGN);
+    signal(SIGPIPE, SIG_IGN);
+
+    fprintf(stderr, "Listening on %s\n", socket_path.c_str());
+
+    while (true) {
+        int conn_fd = accept(listen_fd, nullptr, nullptr);
+        if (conn_fd < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("accept");
+            return 1;
+        }
+
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(listen_fd);
+            listen_fd = -1;
+            handleConnection(conn_fd);
+            _exit(0);
+        }
+        if (pid < 0) {
+            perror("fork");
+        }
+        close(conn_fd);
+    }
+}
+
+void Rubiee::Server::handleConnection(int conn_fd) {
+    // The session waits for its runner, so it needs the default behaviour back
+    signal(SIGCHLD, SIG_DFL);
+
+    std::string source, path;
+    std::vector<std::string> options;
+    char type;
+    std::string payload;
+    while (Protocol::readFrame(conn_fd, type, payload)) {
+        if (type == Protocol::OPTION) {
+            options.push_back(payload);
+        } else if (type == Protocol::PATH) {
+            path = payload;
+        } else if (type == Protocol::SCRIPT) {
+            source = payload;
+        }
+    }
+
+    int output_pipe[2], error_pipe[2], stats_pipe[2];
+    if (pipe(output_pipe) < 0 || pipe(error_pipe) < 0 || pipe(stats_pipe) < 0) {
+        Protocol::writeFrame(conn_fd, Protocol::ERROR, std::string("Cannot create pipes.\n"));
+        Protocol::writeFrame(conn_fd, Protocol::EXIT, Protocol::encodeStatus(1));
+        close(conn_fd);
+        return;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    pid_t runner = fork();
+    if (runner == 0) {
+        close(conn_fd);
+        close(output_pipe[0]);
+        close(error_pipe[0]);
+        close(stats_pipe[0]);
+        runScript(source, path, options, output_pipe[1], error_pipe[1], stats_pipe[1]);
+    }
+    close(output_pipe[1]);
+    close(error_pipe[1]);
+    close(stats_pipe[1]);
+
+    // Stream stdout and stderr of the runner back until both are closed. The
+    // connection is only polled for hang-ups, the client sends nothing more.
+    struct pollfd fds[3] = {
+        { output_pipe[0], POLLIN, 0 },
+        { error_pipe[0], POLLIN, 0 },
+        { conn_fd, 0, 0 }
+    };
+    const char frame_types[2] = { Protocol::OUTPUT, Protocol::ERROR };
+    int open_fds = runner > 0 ? 2 : 0;
+    auto deadline = start + std::chrono::seconds(timeout_seconds);
+    bool killed = false;
+    char buffer[65536];
+
+    while (open_fds > 0) {
+        int timeout_ms = -1;
+        if (timeout_seconds && !killed) {
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                deadline - std::chrono::steady_clock::now()
+            ).count();
+            timeout_ms = left > 0 ? (int) left : 0;
+        }
+
+        int ready = poll(fds, 3, timeout_ms);
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (ready == 0 && !killed) {
+            std::string message = "Script timed out after " + std::to_string(timeout_seconds) + " seconds.\n";
+            Protocol::writeFrame(conn_fd, Protocol::ERROR, message);
+            kill(runner, SIGKILL);
+            killed = true;
+            continue;
+        }
+        // The client went away, nobody is left to read the output
+        if ((fds[2].revents & (POLLHUP | POLLERR)) && !killed) {
+            kill(runner, SIGKILL);
+            killed = true;
+            fds[2].fd = -1;
+        }
+
+        for (int i = 0; i < 2; i++) {
+            if (fds[i].fd < 0 || !fds[i].revents) {
+                continue;
+            }
+            ssize_t n = read(fds[i].fd, buffer, sizeof(buffer));
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                close(fds[i].fd);
+                fds[i].fd = -1;
+                open_fds--;
+                continue;
+            }
+            if (!Protocol::writeFrame(conn_fd, frame_types[i], buffer, n) && !killed) {
+                kill(runner, SIGKILL);
+                killed = true;
+            }
+        }
+    }
+
+    int status = 1;
+    if (runner > 0) {
+        int wait_status = 0;
+        pid_t waited;
+        while ((waited = waitpid(runner, &wait_status, 0)) < 0 && errno == EINTR) {}
+        if (waited == runner && WIFEXITED(wait_status)) {
+            status = WEXITSTATUS(wait_status);
+        } else if (waited == runner && WIFSIGNALED(wait_status)) {
+            status = 128 + WTERMSIG(wait_status);
+        }
+    }
+
+    double total_ms = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start
+    ).count();
+
+    Driver::Timings timings;
+    std::ostringstream stats;
+    if (Protocol::readAll(stats_pipe[0], (char *) &timings, sizeof(timings))) {
+        stats << "parse: " << timings.parse_ms << " ms, "
+              << "require: " << timings.require_ms << " ms, "
+              << "codegen: " << timings.codegen_ms << " ms, "
+              << "execute: " << timings.execute_ms << " ms, ";
+    }
+    stats << "total: " << total_ms << " ms\n";
+    close(stats_pipe[0]);
+
+    Protocol::writeFrame(conn_fd, Protocol::STATS, stats.str());
+    Protocol::writeFrame(conn_fd, Protocol::EXIT, Protocol::encodeStatus(status));
+    close(conn_fd);
+}
+
+void Rubiee::Server::runScript(const std::string &source, const std::string &path, const std::vector<std::string> &options, int output_fd, int error_fd, int stats_fd) {
+    dup2(output_fd, STDOUT_FILENO);
+    dup2(error_fd, STDERR_FILENO);
+    close(output_fd);
+    close(error_fd);
+
+    // Output is streamed back line by line, not when the script ends
+    setvbuf(stdout, nullptr, _IOLBF, 0);
+
+    // Scripts must not read the server's stdin
+    int null_fd = open("/dev/null", O_RDONLY);
+    if (null_fd >= 0) {
+        dup2(null_fd, STDIN_FILENO);
+        close(null_fd);
+    }
+
+    std::istringstream input(source);
+    Driver driver(std::move(jit));
+    driver.set_source_path(path);
+    for (auto option = options.begin(); option != options.end(); ++option) {
+        if (!driver.set_option(*option)) {
+            fprintf(stderr, "Invalid option `%s`.\n", option->c_str());
+            fflush(stderr);
+            close(stats_fd);
+            _exit(1);
+        }
+    }
+    bool ok = driver.parse(input);
+
+    fflush(stdout);
+    fflush(stderr);
+
+    if (ok) {
+        Protocol::writeAll(stats_fd, (const char *) &driver.timings(), sizeof(Driver::Timings));
+    }
+    close(stats_fd);
+    _exit(ok ? 0 : 1);
+}
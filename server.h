@@ -0,0 +1,48 @@
+#ifndef __SERVER_H__
+#define __SERVER_H__ 1
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace llvm {
+namespace orc {
+class KaleidoscopeJIT;
+}
+}
+
+namespace Rubiee {
+
+// A long-running compile server listening on a Unix domain socket.
+//
+// The native target and the JIT are initialized once, before the first
+// connection is accepted. Every submitted script then runs in a forked child
+// which inherits the warm JIT, so scripts are isolated from each other and a
+// crashing script cannot take the server down. A script is killed when it
+// runs longer than the timeout, or when its client goes away. Scripts read
+// no stdin. See `protocol.h` for the wire format.
+class Server {
+public:
+    // No timeout if `timeout_seconds` is 0
+    Server(std::string socket_path, unsigned timeout_seconds = DEFAULT_TIMEOUT);
+    static const unsigned DEFAULT_TIMEOUT = 60;
+    ~Server();
+
+    // Accept connections until the process is killed, returns non-zero if the
+    // socket could not be set up.
+    int run();
+
+private:
+    std::string socket_path;
+    unsigned timeout_seconds;
+    int listen_fd;
+    std::unique_ptr<llvm::orc::KaleidoscopeJIT> jit;
+
+    bool listen();
+    void handleConnection(int conn_fd);
+    void runScript(const std::string &source, const std::string &path, const std::vector<std::string> &options, int output_fd, int error_fd, int stats_fd);
+};
+
+}
+
+#endif
@@ -1,5 +1,9 @@
 #include <stdio.h>
 #include <stdarg.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "runtime.h"
 
 extern "C" void _puts(int num, ...) {
     va_list valist;
@@ -7,11 +11,44 @@ extern "C" void _puts(int num, ...) {
     va_start(valist, num);
 
     for (int i = 0; i < num; i++) {
-        int n = va_arg(valist, int);
+        int type = va_arg(valist, int);
+        if (type == PUTS_DOUBLE) {
+            double n = va_arg(valist, double);
 
-        printf("%d ", n);
+            printf("%s ", Rubiee::formatDouble(n).c_str());
+        } else {
+            long long n = va_arg(valist, long long);
+
+            if (type == PUTS_INT && n < RUBIEE_FIXNUM_MIN) {
+                printf("%s ", Rubiee::formatInteger(n).c_str());
+            } else {
+                printf("%lld ", n);
+            }
+        }
     }
     printf("\n");
 
     va_end(valist);
-}
\ No newline at end of file
+}
+
+std::string Rubiee::formatDouble(double value) {
+    // Like Ruby, plain decimals between 1e-4 and 1e16, exponents otherwise
+    double magnitude = fabs(value);
+    bool fixed = magnitude == 0 || (magnitude >= 1e-4 && magnitude < 1e16);
+
+    char buffer[64];
+    for (int precision = fixed ? 0 : 1; precision <= (fixed ? 24 : 17); precision++) {
+        snprintf(buffer, sizeof(buffer), fixed ? "%.*f" : "%.*g", precision, value);
+        if (strtod(buffer, nullptr) == value) {
+            break;
+        }
+    }
+
+    // `inf` and `nan` are left alone
+    std::string text = buffer;
+    if (text.find_first_of(".in") == std::string::npos) {
+        size_t exponent = text.find('e');
+        text.insert(exponent == std::string::npos ? text.size() : exponent, ".0");
+    }
+    return text;
+}
@@ -0,0 +1,432 @@
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "runtime.h"
+
+// Arbitrary precision integers for Rubiee scripts.
+//
+// Generated code does 64-bit arithmetic and only calls in here when it
+// overflows, or when an operand is already a bignum. A bignum is passed
+// around as a handle: an integer below `RUBIEE_FIXNUM_MIN`, which no result
+// of the fast path can be. Bignums are interned, and results which fit in a
+// fixnum are always returned as one, so two integers are equal exactly when
+// their 64 bits are.
+//
+// Bignums nothing refers to anymore are collected, like MRI does it: the
+// stack of the thread running the script is scanned conservatively, every
+// word which could be a handle keeps its bignum, as do the entries of hash
+// tables and the memory registered with `_bignum_keep`, e.g. memo caches.
+// Handles of collected bignums are reused.
+
+namespace {
+
+typedef std::vector<uint32_t> Magnitude;
+
+struct Bignum {
+    bool negative;
+    // Little-endian limbs without leading zeros, empty for zero
+    Magnitude limbs;
+};
+
+// Products of operands of at least that many limbs use Karatsuba
+const size_t KARATSUBA_THRESHOLD = 32;
+
+// Collections happen once twice as many bignums as the last one kept are
+// live, and at least that many
+const size_t MIN_COLLECTION = 1 << 16;
+
+// Bignums by sign and limbs, see `keyOf`, and their keys by handle, `nullptr`
+// for collected ones. Nodes of the map never move, so the limbs are only
+// stored in the key.
+std::unordered_map<std::string, long long> interned;
+std::vector<const std::string *> bignums;
+std::vector<long long> free_handles;
+size_t next_collection = MIN_COLLECTION;
+
+// Memory scanned by collections, by address, see `_bignum_keep`
+std::map<const void *, size_t> kept_memory;
+
+inline bool isHandle(long long value) {
+    return value < RUBIEE_FIXNUM_MIN;
+}
+
+void trim(Magnitude &a) {
+    while (!a.empty() && a.back() == 0) {
+        a.pop_back();
+    }
+}
+
+std::string keyOf(const Bignum &value) {
+    std::string key(1, value.negative ? '-' : '+');
+    key.append(reinterpret_cast<const char *>(value.limbs.data()), value.limbs.size() * sizeof(uint32_t));
+    return key;
+}
+
+Bignum fromKey(const std::string &key) {
+    Bignum result;
+    result.negative = key[0] == '-';
+    result.limbs.resize((key.size() - 1) / sizeof(uint32_t));
+    memcpy(result.limbs.data(), key.data() + 1, key.size() - 1);
+    return result;
+}
+
+Bignum fromInteger(long long value) {
+    if (isHandle(value)) {
+        uint64_t index = (uint64_t) value - (uint64_t) INT64_MIN;
+        if (index >= bignums.size() || !bignums[index]) {
+            fprintf(stderr, "Big integer `%lld` does not exist.\n", value);
+            return Bignum();
+        }
+        return fromKey(*bignums[index]);
+    }
+
+    Bignum result;
+    result.negative = value < 0;
+    uint64_t magnitude = value < 0 ? 0 - (uint64_t) value : (uint64_t) value;
+    while (magnitude) {
+        result.limbs.push_back((uint32_t) magnitude);
+        magnitude >>= 32;
+    }
+    return result;
+}
+
+// Mark the bignums of every handle among the aligned words of [begin, end)
+void markWords(const void *begin, const void *end, std::vector<bool> &marked) {
+    uintptr_t first = ((uintptr_t) begin + sizeof(long long) - 1) & ~(uintptr_t) (sizeof(long long) - 1);
+    for (const long long *word = (const long long *) first; word + 1 <= (const long long *) end; word++) {
+        uint64_t index = (uint64_t) *word - (uint64_t) INT64_MIN;
+        if (isHandle(*word) && index < marked.size()) {
+            marked[index] = true;
+        }
+    }
+}
+
+// Scan from the frame of this function, below the frames of its callers, to
+// the top of the stack
+__attribute__((noinline)) void markStack(std::vector<bool> &marked) {
+    pthread_attr_t attributes;
+    void *stack;
+    size_t stack_size;
+    if (pthread_getattr_np(pthread_self(), &attributes) != 0) {
+        fprintf(stderr, "Cannot find the stack to collect big integers.\n");
+        abort();
+    }
+    pthread_attr_getstack(&attributes, &stack, &stack_size);
+    pthread_attr_destroy(&attributes);
+
+    volatile char bottom = 0;
+    markWords((const void *) &bottom, (const char *) stack + stack_size, marked);
+}
+
+void collect() {
+    // Callers compiled by the JIT may keep handles in callee-saved registers,
+    // this spills them to the stack
+    __builtin_unwind_init();
+
+    std::vector<bool> marked(bignums.size());
+    markStack(marked);
+    for (int handle = 0; handle < _rubiee_hash_count; handle++) {
+        HashTable *table = _rubiee_hash_tables[handle];
+        if (!table) {
+            continue;
+        }
+        unsigned long long capacity = (table->group_mask + 1) * HASH_GROUP_SIZE;
+        for (unsigned long long slot = 0; slot < capacity; slot++) {
+            if (table->ctrl[slot] >= 0) {
+                markWords(table->slots + 2 * slot, table->slots + 2 * slot + 2, marked);
+            }
+        }
+    }
+    for (auto memory = kept_memory.begin(); memory != kept_memory.end(); ++memory) {
+        markWords(memory->first, (const char *) memory->first + memory->second, marked);
+    }
+
+    for (size_t index = 0; index < bignums.size(); index++) {
+        if (bignums[index] && !marked[index]) {
+            interned.erase(interned.find(*bignums[index]));
+            bignums[index] = nullptr;
+            free_handles.push_back(INT64_MIN + (long long) index);
+        }
+    }
+    next_collection = std::max(MIN_COLLECTION, 2 * interned.size());
+}
+
+long long toInteger(Bignum value) {
+    trim(value.limbs);
+    if (value.limbs.empty()) {
+        return 0;
+    }
+
+    // Fixnums are the integers from `RUBIEE_FIXNUM_MIN` to `INT64_MAX`
+    if (value.limbs.size() <= 2) {
+        uint64_t magnitude = value.limbs[0] | (value.limbs.size() > 1 ? (uint64_t) value.limbs[1] << 32 : 0);
+        if (!value.negative && magnitude <= (uint64_t) INT64_MAX) {
+            return (long long) magnitude;
+        }
+        if (value.negative && magnitude <= 0 - (uint64_t) RUBIEE_FIXNUM_MIN) {
+            return (long long) (0 - magnitude);
+        }
+    }
+
+    std::string key = keyOf(value);
+    auto found = interned.find(key);
+    if (found != interned.end()) {
+        return found->second;
+    }
+
+    if (interned.size() >= next_collection) {
+        collect();
+    }
+    if (free_handles.empty()) {
+        if (bignums.size() >= (uint64_t) RUBIEE_FIXNUM_MIN - INT64_MIN) {
+            fprintf(stderr, "Too many big integers.\n");
+            abort();
+        }
+        free_handles.push_back(INT64_MIN + (long long) bignums.size());
+        bignums.push_back(nullptr);
+    }
+    long long handle = free_handles.back();
+    free_handles.pop_back();
+    bignums[(uint64_t) handle - (uint64_t) INT64_MIN] = &interned.emplace(std::move(key), handle).first->first;
+    return handle;
+}
+
+int compareMagnitudes(const Magnitude &a, const Magnitude &b) {
+    if (a.size() != b.size()) {
+        return a.size() < b.size() ? -1 : 1;
+    }
+    for (size_t i = a.size(); i-- > 0; ) {
+        if (a[i] != b[i]) {
+            return a[i] < b[i] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+Magnitude addMagnitudes(const Magnitude &a, const Magnitude &b) {
+    const Magnitude &longer = a.size() >= b.size() ? a : b;
+    const Magnitude &shorter = a.size() >= b.size() ? b : a;
+
+    Magnitude sum(longer.size() + 1);
+    uint64_t carry = 0;
+    for (size_t i = 0; i < longer.size(); i++) {
+        carry += (uint64_t) longer[i] + (i < shorter.size() ? shorter[i] : 0);
+        sum[i] = (uint32_t) carry;
+        carry >>= 32;
+    }
+    sum[longer.size()] = (uint32_t) carry;
+    trim(sum);
+    return sum;
+}
+
+// `a - b`, `a` must not be smaller than `b`
+Magnitude subtractMagnitudes(const Magnitude &a, const Magnitude &b) {
+    Magnitude difference(a.size());
+    int64_t borrow = 0;
+    for (size_t i = 0; i < a.size(); i++) {
+        int64_t limb = (int64_t) a[i] - (i < b.size() ? b[i] : 0) - borrow;
+        borrow = limb < 0;
+        difference[i] = (uint32_t) (limb + (borrow << 32));
+    }
+    trim(difference);
+    return difference;
+}
+
+// Add `b << (32 * shift)` to `a` in place
+void addShifted(Magnitude &a, const Magnitude &b, size_t shift) {
+    if (a.size() < b.size() + shift + 1) {
+        a.resize(b.size() + shift + 1);
+    }
+    uint64_t carry = 0;
+    size_t i = 0;
+    for (; i < b.size(); i++) {
+        carry += (uint64_t) a[i + shift] + b[i];
+        a[i + shift] = (uint32_t) carry;
+        carry >>= 32;
+    }
+    for (i += shift; carry; i++) {
+        if (i == a.size()) {
+            a.push_back(0);
+        }
+        carry += a[i];
+        a[i] = (uint32_t) carry;
+        carry >>= 32;
+    }
+}
+
+Magnitude multiplySchoolbook(const Magnitude &a, const Magnitude &b) {
+    Magnitude product(a.size() + b.size());
+    for (size_t i = 0; i < a.size(); i++) {
+        uint64_t carry = 0;
+        for (size_t j = 0; j < b.size(); j++) {
+            carry += (uint64_t) a[i] * b[j] + product[i + j];
+            product[i + j] = (uint32_t) carry;
+            carry >>= 32;
+        }
+        product[i + b.size()] = (uint32_t) carry;
+    }
+    trim(product);
+    return product;
+}
+
+Magnitude slice(const Magnitude &a, size_t begin, size_t end) {
+    begin = std::min(begin, a.size());
+    end = std::min(end, a.size());
+    Magnitude part(a.begin() + begin, a.begin() + end);
+    trim(part);
+    return part;
+}
+
+// Karatsuba: with a = a1 B + a0 and b = b1 B + b0, three products of half the
+// size instead of four, since a1 b0 + a0 b1 = (a0 + a1)(b0 + b1) - a0 b0 - a1 b1
+Magnitude multiplyMagnitudes(const Magnitude &a, const Magnitude &b) {
+    if (a.empty() || b.empty()) {
+        return Magnitude();
+    }
+    if (std::min(a.size(), b.size()) < KARATSUBA_THRESHOLD) {
+        return multiplySchoolbook(a, b);
+    }
+
+    size_t half = std::max(a.size(), b.size()) / 2;
+    Magnitude a0 = slice(a, 0, half), a1 = slice(a, half, a.size());
+    Magnitude b0 = slice(b, 0, half), b1 = slice(b, half, b.size());
+
+    Magnitude low = multiplyMagnitudes(a0, b0);
+    Magnitude high = multiplyMagnitudes(a1, b1);
+    Magnitude middle = multiplyMagnitudes(addMagnitudes(a0, a1), addMagnitudes(b0, b1));
+    middle = subtractMagnitudes(subtractMagnitudes(middle, low), high);
+
+    Magnitude product = low;
+    addShifted(product, middle, half);
+    addShifted(product, high, 2 * half);
+    trim(product);
+    return product;
+}
+
+Bignum add(const Bignum &a, const Bignum &b) {
+    Bignum sum;
+    if (a.negative == b.negative) {
+        sum.negative = a.negative;
+        sum.limbs = addMagnitudes(a.limbs, b.limbs);
+    } else if (compareMagnitudes(a.limbs, b.limbs) >= 0) {
+        sum.negative = a.negative;
+        sum.limbs = subtractMagnitudes(a.limbs, b.limbs);
+    } else {
+        sum.negative = b.negative;
+        sum.limbs = subtractMagnitudes(b.limbs, a.limbs);
+    }
+    return sum;
+}
+
+int compare(const Bignum &a, const Bignum &b) {
+    if (a.negative != b.negative) {
+        return a.negative ? -1 : 1;
+    }
+    int order = compareMagnitudes(a.limbs, b.limbs);
+    return a.negative ? -order : order;
+}
+
+}
+
+extern "C" long long _bignum_add(long long a, long long b) {
+    return toInteger(add(fromInteger(a), fromInteger(b)));
+}
+
+extern "C" long long _bignum_sub(long long a, long long b) {
+    Bignum negated = fromInteger(b);
+    negated.negative = !negated.negative;
+    return toInteger(add(fromInteger(a), negated));
+}
+
+extern "C" long long _bignum_mul(long long a, long long b) {
+    Bignum x = fromInteger(a), y = fromInteger(b);
+    Bignum product;
+    product.negative = x.negative != y.negative;
+    product.limbs = multiplyMagnitudes(x.limbs, y.limbs);
+    return toInteger(product);
+}
+
+extern "C" int _bignum_compare(long long a, long long b) {
+    return compare(fromInteger(a), fromInteger(b));
+}
+
+extern "C" double _bignum_to_double(long long a) {
+    Bignum value = fromInteger(a);
+    double result = 0;
+    for (size_t i = value.limbs.size(); i-- > 0; ) {
+        result = result * 4294967296.0 + value.limbs[i];
+    }
+    return value.negative ? -result : result;
+}
+
+// Generated code only calls this for values which are not fixnums
+extern "C" long long _bignum_from_double(double a) {
+    if (isnan(a)) {
+        return 0;
+    }
+    if (isinf(a)) {
+        fprintf(stderr, "Cannot convert `%s` to an integer.\n", a > 0 ? "Infinity" : "-Infinity");
+        return 0;
+    }
+
+    // Dividing by a power of two is exact, so are the remainders
+    Bignum value;
+    value.negative = a < 0;
+    for (double magnitude = trunc(fabs(a)); magnitude >= 1; magnitude = floor(magnitude / 4294967296.0)) {
+        value.limbs.push_back((uint32_t) fmod(magnitude, 4294967296.0));
+    }
+    return toInteger(value);
+}
+
+extern "C" void _bignum_keep(const void *memory, long long bytes) {
+    kept_memory[memory] = bytes;
+}
+
+extern "C" void _bignum_forget(const void *memory) {
+    kept_memory.erase(memory);
+}
+
+extern "C" void _bignum_range_error() {
+    // Keep the error after the output which led to it
+    fflush(stdout);
+    fprintf(stderr, "Ranges of big integers are not supported.\n");
+}
+
+std::string Rubiee::formatInteger(long long value) {
+    if (!isHandle(value)) {
+        return std::to_string(value);
+    }
+
+    // Divide by 10^9 until nothing is left, each remainder is 9 digits
+    Bignum big = fromInteger(value);
+    Magnitude magnitude = big.limbs;
+    std::vector<uint32_t> chunks;
+    while (!magnitude.empty()) {
+        uint64_t remainder = 0;
+        for (size_t i = magnitude.size(); i-- > 0; ) {
+            uint64_t current = (remainder << 32) | magnitude[i];
+            magnitude[i] = (uint32_t) (current / 1000000000);
+            remainder = current % 1000000000;
+        }
+        chunks.push_back((uint32_t) remainder);
+        trim(magnitude);
+    }
+
+    std::string text = big.negative ? "-" : "";
+    text += std::to_string(chunks.back());
+    char buffer[16];
+    for (size_t i = chunks.size() - 1; i-- > 0; ) {
+        snprintf(buffer, sizeof(buffer), "%09u", chunks[i]);
+        text += buffer;
+    }
+    return text;
+}
@@ -0,0 +1,417 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+#include "runtime.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Hash tables for Rubiee scripts.
+//
+// Tables use open addressing in the style of Abseil's Swiss tables. Every
+// slot has a control byte holding 7 bits of the hash of its key, and slots are
+// probed a group of 16 at a time: a single SSE2 comparison finds the slots of
+// a group whose control byte matches, so most lookups read one cache line of
+// control bytes and one slot. Keys and values are stored side by side.
+
+HashTable **_rubiee_hash_tables = nullptr;
+int _rubiee_hash_count = 0;
+
+namespace {
+
+// Tables grow when more than 7/8 of their slots are taken
+const long long MAX_LOAD_NUMERATOR = 7;
+const long long MAX_LOAD_DENOMINATOR = 8;
+
+// Largest size `_hash_new` allocates for up front, tables grow past it as
+// entries are added
+const long long MAX_INITIAL_SIZE = 1LL << 26;
+
+std::vector<HashTable *> tables;
+// Handles of freed tables, reused by `_hash_new`
+std::vector<int> free_tables;
+
+// Generated code inlines this hash, see `CodeGenVisitor::generateHashLookup`
+inline uint64_t hashKey(long long key) {
+    uint64_t hash = (uint64_t) key * 0x9E3779B97F4A7C15ULL;
+    return hash ^ (hash >> 32);
+}
+
+inline int8_t controlOf(uint64_t hash) {
+    return hash & 0x7F;
+}
+
+inline uint64_t homeGroupOf(const HashTable *table, uint64_t hash) {
+    return (hash >> 7) & table->group_mask;
+}
+
+inline long long capacityOf(const HashTable *table) {
+    return (table->group_mask + 1) * HASH_GROUP_SIZE;
+}
+
+// Control bytes of a group, as bit masks of the slots matching a condition
+class Group {
+public:
+    explicit Group(const int8_t *ctrl) {
+#ifdef __SSE2__
+        bytes = _mm_load_si128(reinterpret_cast<const __m128i *>(ctrl));
+#else
+        memcpy(bytes, ctrl, HASH_GROUP_SIZE);
+#endif
+    }
+
+    uint32_t match(int8_t control) const {
+#ifdef __SSE2__
+        return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(control), bytes));
+#else
+        uint32_t mask = 0;
+        for (int i = 0; i < HASH_GROUP_SIZE; i++) {
+            mask |= (uint32_t) (bytes[i] == control) << i;
+        }
+        return mask;
+#endif
+    }
+
+    uint32_t matchEmpty() const {
+        return match(HASH_EMPTY);
+    }
+
+    // Both markers are negative, taken slots are not
+    uint32_t matchEmptyOrDeleted() const {
+#ifdef __SSE2__
+        return _mm_movemask_epi8(bytes);
+#else
+        uint32_t mask = 0;
+        for (int i = 0; i < HASH_GROUP_SIZE; i++) {
+            mask |= (uint32_t) (bytes[i] < 0) << i;
+        }
+        return mask;
+#endif
+    }
+
+private:
+#ifdef __SSE2__
+    __m128i bytes;
+#else
+    int8_t bytes[HASH_GROUP_SIZE];
+#endif
+};
+
+inline int lowestBit(uint32_t mask) {
+    return __builtin_ctz(mask);
+}
+
+// Groups are probed in triangular steps, which visit every group once when
+// their number is a power of two
+class ProbeSequence {
+public:
+    ProbeSequence(const HashTable *table, uint64_t hash)
+                  : group(homeGroupOf(table, hash)), mask(table->group_mask), step(0) {}
+
+    uint64_t current() const {
+        return group;
+    }
+
+    void next() {
+        step++;
+        group = (group + step) & mask;
+    }
+
+private:
+    uint64_t group;
+    uint64_t mask;
+    uint64_t step;
+};
+
+void allocate(HashTable *table, uint64_t group_num) {
+    size_t capacity = group_num * HASH_GROUP_SIZE;
+    void *ctrl = nullptr;
+    if (posix_memalign(&ctrl, HASH_GROUP_SIZE, capacity) != 0) {
+        fprintf(stderr, "Cannot allocate a hash table of %zu slots.\n", capacity);
+        abort();
+    }
+    void *slots = malloc(capacity * 2 * sizeof(long long));
+    if (!slots) {
+        fprintf(stderr, "Cannot allocate a hash table of %zu slots.\n", capacity);
+        abort();
+    }
+    memset(ctrl, HASH_EMPTY, capacity);
+
+    table->ctrl = static_cast<int8_t *>(ctrl);
+    table->slots = static_cast<long long *>(slots);
+    table->group_mask = group_num - 1;
+    table->size = 0;
+    table->tombstones = 0;
+}
+
+// Slot of `key`, `-1` if it is not in the table
+long long find(const HashTable *table, long long key) {
+    uint64_t hash = hashKey(key);
+    int8_t control = controlOf(hash);
+
+    for (ProbeSequence probe(table, hash); ; probe.next()) {
+        uint64_t first = probe.current() * HASH_GROUP_SIZE;
+        Group group(table->ctrl + first);
+
+        for (uint32_t mask = group.match(control); mask; mask &= mask - 1) {
+            long long slot = first + lowestBit(mask);
+            if (table->slots[2 * slot] == key) {
+                return slot;
+            }
+        }
+
+        // A key is never placed past a group with an empty slot
+        if (group.matchEmpty()) {
+            return -1;
+        }
+    }
+}
+
+// First empty or deleted slot for a key of `hash`
+long long findFree(const HashTable *table, uint64_t hash) {
+    for (ProbeSequence probe(table, hash); ; probe.next()) {
+        uint64_t first = probe.current() * HASH_GROUP_SIZE;
+        uint32_t mask = Group(table->ctrl + first).matchEmptyOrDeleted();
+        if (mask) {
+            return first + lowestBit(mask);
+        }
+    }
+}
+
+void place(HashTable *table, long long slot, uint64_t hash, long long key, long long value) {
+    if (table->ctrl[slot] == HASH_DELETED) {
+        table->tombstones--;
+    }
+    table->ctrl[slot] = controlOf(hash);
+    table->slots[2 * slot] = key;
+    table->slots[2 * slot + 1] = value;
+    table->size++;
+}
+
+void rehash(HashTable *table, uint64_t group_num) {
+    HashTable old = *table;
+    long long old_capacity = capacityOf(&old);
+
+    allocate(table, group_num);
+    for (long long slot = 0; slot < old_capacity; slot++) {
+        if (old.ctrl[slot] >= 0) {
+            long long key = old.slots[2 * slot];
+            uint64_t hash = hashKey(key);
+            place(table, findFree(table, hash), hash, key, old.slots[2 * slot + 1]);
+        }
+    }
+
+    free(old.ctrl);
+    free(old.slots);
+}
+
+// Smallest number of groups holding `size` entries under the maximum load,
+// `size` is at most `MAX_INITIAL_SIZE` or the size of an existing table
+uint64_t groupsFor(long long size) {
+    uint64_t group_num = 1;
+    while ((long long) (group_num * HASH_GROUP_SIZE) * MAX_LOAD_NUMERATOR < size * MAX_LOAD_DENOMINATOR) {
+        group_num *= 2;
+    }
+    return group_num;
+}
+
+HashTable *getTable(int table) {
+    if (table < 0 || table >= _rubiee_hash_count || !tables[table]) {
+        fprintf(stderr, "Hash `%d` does not exist.\n", table);
+        return nullptr;
+    }
+    return tables[table];
+}
+
+// Slot at a position of `_hash_next`, `-1` if it holds no entry
+long long slotAt(const HashTable *table, long long position) {
+    long long slot = position - 1;
+    if (slot < 0 || slot >= capacityOf(table) || table->ctrl[slot] < 0) {
+        fprintf(stderr, "Hash position `%lld` holds no entry.\n", position);
+        return -1;
+    }
+    return slot;
+}
+
+void printStats(FILE *out, int handle, const HashTable *table) {
+    long long capacity = capacityOf(table);
+
+    // Number of groups probed to find each key
+    long long total_probes = 0;
+    long long max_probes = 0;
+    for (long long slot = 0; slot < capacity; slot++) {
+        if (table->ctrl[slot] < 0) {
+            continue;
+        }
+        long long probes = 1;
+        for (ProbeSequence probe(table, hashKey(table->slots[2 * slot]));
+             probe.current() != (uint64_t) slot / HASH_GROUP_SIZE;
+             probe.next()) {
+            probes++;
+        }
+        total_probes += probes;
+        max_probes = probes > max_probes ? probes : max_probes;
+    }
+
+    fprintf(out, "hash %d: %lld entries, %lld slots, %.1f%% load, %lld deleted, %.2f groups probed on average, %lld at most\n",
+            handle,
+            table->size,
+            capacity,
+            100.0 * table->size / capacity,
+            table->tombstones,
+            table->size ? (double) total_probes / table->size : 0.0,
+            max_probes);
+}
+
+}
+
+void Rubiee::reportHashStats(FILE *out) {
+    for (int table = 0; table < _rubiee_hash_count; table++) {
+        if (tables[table]) {
+            printStats(out, table, tables[table]);
+        }
+    }
+}
+
+extern "C" int _hash_new(long long capacity) {
+    if (capacity > MAX_INITIAL_SIZE) {
+        fprintf(stderr, "Hash size `%lld` is too large, using %lld.\n", capacity, MAX_INITIAL_SIZE);
+        capacity = MAX_INITIAL_SIZE;
+    }
+
+    HashTable *table = new HashTable();
+    allocate(table, groupsFor(capacity > 0 ? capacity : 0));
+
+    if (!free_tables.empty()) {
+        int handle = free_tables.back();
+        free_tables.pop_back();
+        tables[handle] = table;
+        return handle;
+    }
+
+    tables.push_back(table);
+    // Generated code reads the tables directly
+    _rubiee_hash_tables = tables.data();
+    _rubiee_hash_count = tables.size();
+    return tables.size() - 1;
+}
+
+// Missing keys are `0`, so counting needs no check
+extern "C" long long _hash_get(int handle, long long key) {
+    HashTable *table = getTable(handle);
+    if (!table) {
+        return 0;
+    }
+    long long slot = find(table, key);
+    return slot < 0 ? 0 : table->slots[2 * slot + 1];
+}
+
+extern "C" int _hash_has(int handle, long long key) {
+    HashTable *table = getTable(handle);
+    return table && find(table, key) >= 0 ? 1 : 0;
+}
+
+extern "C" long long _hash_set(int handle, long long key, long long value) {
+    HashTable *table = getTable(handle);
+    if (!table) {
+        return value;
+    }
+
+    long long slot = find(table, key);
+    if (slot >= 0) {
+        table->slots[2 * slot + 1] = value;
+        return value;
+    }
+
+    // Deleted slots count as taken, they make probing longer just the same.
+    // Grow when entries fill the table, clean up when deleted slots do.
+    long long capacity = capacityOf(table);
+    if ((table->size + table->tombstones + 1) * MAX_LOAD_DENOMINATOR > capacity * MAX_LOAD_NUMERATOR) {
+        uint64_t group_num = groupsFor(table->size + 1);
+        rehash(table, group_num > table->group_mask + 1 ? group_num : table->group_mask + 1);
+    }
+
+    uint64_t hash = hashKey(key);
+    place(table, findFree(table, hash), hash, key, value);
+    return value;
+}
+
+extern "C" int _hash_delete(int handle, long long key) {
+    HashTable *table = getTable(handle);
+    long long slot = table ? find(table, key) : -1;
+    if (slot < 0) {
+        return 0;
+    }
+
+    // A lookup only goes past full groups, so the slot can be emptied if its
+    // group has an empty slot already
+    uint64_t first = slot / HASH_GROUP_SIZE * HASH_GROUP_SIZE;
+    if (Group(table->ctrl + first).matchEmpty()) {
+        table->ctrl[slot] = HASH_EMPTY;
+    } else {
+        table->ctrl[slot] = HASH_DELETED;
+        table->tombstones++;
+    }
+    table->size--;
+    return 1;
+}
+
+extern "C" long long _hash_size(int handle) {
+    HashTable *table = getTable(handle);
+    return table ? table->size : 0;
+}
+
+extern "C" long long _hash_next(int handle, long long position) {
+    HashTable *table = getTable(handle);
+    if (!table) {
+        return 0;
+    }
+
+    // Positions are slots plus one, so that `0` is before the first slot
+    long long capacity = capacityOf(table);
+    for (long long slot = position > 0 ? position : 0; slot < capacity; slot++) {
+        if (table->ctrl[slot] >= 0) {
+            return slot + 1;
+        }
+    }
+    return 0;
+}
+
+extern "C" long long _hash_key(int handle, long long position) {
+    HashTable *table = getTable(handle);
+    long long slot = table ? slotAt(table, position) : -1;
+    return slot < 0 ? 0 : table->slots[2 * slot];
+}
+
+extern "C" long long _hash_value(int handle, long long position) {
+    HashTable *table = getTable(handle);
+    long long slot = table ? slotAt(table, position) : -1;
+    return slot < 0 ? 0 : table->slots[2 * slot + 1];
+}
+
+extern "C" int _hash_free(int handle) {
+    HashTable *table = getTable(handle);
+    if (!table) {
+        return 0;
+    }
+
+    free(table->ctrl);
+    free(table->slots);
+    delete table;
+    tables[handle] = nullptr;
+    free_tables.push_back(handle);
+    return 0;
+}
+
+extern "C" int _hash_stats(int handle) {
+    HashTable *table = getTable(handle);
+    if (table) {
+        fflush(stdout);
+        printStats(stderr, handle, table);
+    }
+    return 0;
+}
@@ -0,0 +1,262 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+#include "runtime.h"
+
+// Integer input for Rubiee scripts.
+//
+// Regular files (including a redirected stdin) are memory-mapped and parsed
+// in place. Pipes are read in large chunks, and only the part of a chunk that
+// ends at a delimiter is exposed to the parser, so a number never straddles
+// two chunks. Either way the data never goes through the lexer or the parser.
+
+namespace {
+
+const size_t CHUNK_SIZE = 1 << 20;
+
+inline bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+// SWAR helpers, see "Fast numeric string to int" by Wojciech Muła: test and
+// convert eight ASCII digits at once with a few 64-bit multiplications.
+inline bool isEightDigits(const char *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return ((v & 0xF0F0F0F0F0F0F0F0ULL) |
+            (((v + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4)) == 0x3333333333333333ULL;
+}
+
+inline uint32_t parseEightDigits(const char *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    v = (v & 0x0F0F0F0F0F0F0F0FULL) * 2561 >> 8;
+    v = (v & 0x00FF00FF00FF00FFULL) * 6553601 >> 16;
+    return (uint32_t) ((v & 0x0000FFFF0000FFFFULL) * 42949672960001ULL >> 32);
+}
+#endif
+
+class InputStream {
+public:
+    InputStream(int fd) : fd(fd), mapped(nullptr), mapped_size(0), pos(nullptr), limit(nullptr), end(nullptr), eof(false) {
+        struct stat st;
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+            // A redirected stdin may already be past the start of the file
+            off_t offset = lseek(fd, 0, SEEK_CUR);
+            void *addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (offset >= 0 && addr != MAP_FAILED) {
+                madvise(addr, st.st_size, MADV_SEQUENTIAL);
+                mapped = static_cast<const char *>(addr);
+                mapped_size = st.st_size;
+                pos = mapped + std::min((size_t) offset, mapped_size);
+                limit = end = mapped + mapped_size;
+                eof = true;
+                return;
+            }
+            if (addr != MAP_FAILED) {
+                munmap(addr, st.st_size);
+            }
+        }
+        buffer.resize(CHUNK_SIZE);
+        pos = limit = end = buffer.data();
+    }
+
+    ~InputStream() {
+        if (mapped) {
+            munmap(const_cast<char *>(mapped), mapped_size);
+        }
+        if (fd != STDIN_FILENO) {
+            close(fd);
+        }
+    }
+
+    bool hasInt() {
+        skipDelimiters();
+        return pos < limit;
+    }
+
+    int readInt() {
+        if (!hasInt()) {
+            return 0;
+        }
+
+        bool negative = false;
+        if (*pos == '-') {
+            negative = true;
+            ++pos;
+        }
+
+        uint64_t value = 0;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        while (limit - pos >= 8 && isEightDigits(pos)) {
+            value = value * 100000000 + parseEightDigits(pos);
+            pos += 8;
+        }
+#endif
+        while (pos < limit && isDigit(*pos)) {
+            value = value * 10 + (*pos - '0');
+            ++pos;
+        }
+
+        return negative ? (int) (0 - (uint32_t) value) : (int) (uint32_t) value;
+    }
+
+private:
+    int fd;
+    const char *mapped;
+    size_t mapped_size;
+    std::vector<char> buffer;
+    // [pos, limit) can be parsed safely, [limit, end) is a partial number
+    const char *pos, *limit, *end;
+    bool eof;
+
+    void skipDelimiters() {
+        while (true) {
+            while (pos < limit && !isDigit(*pos) && !(*pos == '-' && pos + 1 < limit && isDigit(pos[1]))) {
+                ++pos;
+            }
+            if (pos < limit || !refill()) {
+                return;
+            }
+        }
+    }
+
+    bool refill() {
+        if (eof) {
+            if (limit == end) {
+                return false;
+            }
+            limit = end;
+            return true;
+        }
+
+        // Keep the unconsumed partial number at the front of the buffer
+        size_t kept = end - pos;
+        memmove(buffer.data(), pos, kept);
+        if (buffer.size() - kept < CHUNK_SIZE / 2) {
+            buffer.resize(buffer.size() * 2);
+        }
+
+        ssize_t n;
+        do {
+            n = read(fd, buffer.data() + kept, buffer.size() - kept);
+        } while (n < 0 && errno == EINTR);
+
+        pos = buffer.data();
+        end = pos + kept + (n > 0 ? n : 0);
+        if (n <= 0) {
+            eof = true;
+            limit = end;
+            return kept > 0;
+        }
+
+        // Only expose the data up to the last delimiter
+        limit = end;
+        while (limit > pos && (isDigit(limit[-1]) || limit[-1] == '-')) {
+            --limit;
+        }
+        return true;
+    }
+};
+
+std::vector<std::string> input_files;
+std::vector<std::unique_ptr<InputStream>> streams;
+std::vector<std::vector<int>> arrays;
+// Handles of freed arrays, reused by `_read_ints`
+std::vector<int> free_arrays;
+
+InputStream *getStream(int stream) {
+    if (stream < 0 || (size_t) stream > input_files.size()) {
+        fprintf(stderr, "Input stream `%d` does not exist.\n", stream);
+        return nullptr;
+    }
+
+    if (streams.size() <= (size_t) stream) {
+        streams.resize(stream + 1);
+    }
+    if (!streams[stream]) {
+        int fd = STDIN_FILENO;
+        if (stream > 0) {
+            fd = open(input_files[stream - 1].c_str(), O_RDONLY);
+            if (fd < 0) {
+                fprintf(stderr, "Cannot open input file `%s`.\n", input_files[stream - 1].c_str());
+                return nullptr;
+            }
+        }
+        streams[stream].reset(new InputStream(fd));
+    }
+    return streams[stream].get();
+}
+
+}
+
+void Rubiee::setInputFiles(std::vector<std::string> files) {
+    input_files = std::move(files);
+    streams.clear();
+}
+
+extern "C" int _read_int(int stream) {
+    InputStream *input = getStream(stream);
+    return input ? input->readInt() : 0;
+}
+
+extern "C" int _has_int(int stream) {
+    InputStream *input = getStream(stream);
+    return input && input->hasInt() ? 1 : 0;
+}
+
+extern "C" int _read_ints(int stream) {
+    InputStream *input = getStream(stream);
+
+    std::vector<int> values;
+    while (input && input->hasInt()) {
+        values.push_back(input->readInt());
+    }
+
+    if (free_arrays.empty()) {
+        arrays.push_back(std::move(values));
+        return arrays.size() - 1;
+    }
+    int array = free_arrays.back();
+    free_arrays.pop_back();
+    arrays[array] = std::move(values);
+    return array;
+}
+
+extern "C" int _array_size(int array) {
+    if (array < 0 || (size_t) array >= arrays.size()) {
+        fprintf(stderr, "Array `%d` does not exist.\n", array);
+        return 0;
+    }
+    return arrays[array].size();
+}
+
+extern "C" int _array_free(int array) {
+    if (array < 0 || (size_t) array >= arrays.size()) {
+        fprintf(stderr, "Array `%d` does not exist.\n", array);
+        return 0;
+    }
+    std::vector<int>().swap(arrays[array]);
+    free_arrays.push_back(array);
+    return 0;
+}
+
+extern "C" int _array_get(int array, int index) {
+    if (array < 0 || (size_t) array >= arrays.size() || 
+        index < 0 || (size_t) index >= arrays[array].size()) {
+        fprintf(stderr, "Array index `%d` is out of range.\n", index);
+        return 0;
+    }
+    return arrays[array][index];
+}
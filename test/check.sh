@@ -0,0 +1,95 @@
+#!/bin/bash
+# Tests run by `make check` from the root of the tree.
+#
+# test/run/*.rb must print `<name>.out` with both front ends, when run with
+# `main` and when submitted through `rubiee-client` to a compile server
+# started for the tests.
+# test/run/*.sh run `main` themselves, e.g. to give it input, and must print
+# `<name>.out` too.
+#
+# test/parse/*.rb go through both front ends, which must print the same AST,
+# or the same errors, and exit the same way. If `<name>.expected` exists, it
+# is what both must print.
+#
+# test/embed uses the embedding API of `librubiee.a`, and must exit with 0.
+
+failures=0
+
+fail() {
+    echo "FAIL $1"
+    failures=$((failures + 1))
+}
+
+workdir=$(mktemp -d /tmp/rubiee-check.XXXXXX)
+socket="$workdir/server.sock"
+timeout_socket="$workdir/timeout.sock"
+./main --server "$socket" 2> /dev/null &
+server=$!
+./main --server "$timeout_socket" --timeout=1 2> /dev/null &
+timeout_server=$!
+trap 'kill $server $timeout_server 2> /dev/null; rm -rf "$workdir"' EXIT
+
+for i in $(seq 100); do
+    [ -S "$socket" ] && [ -S "$timeout_socket" ] && break
+    sleep 0.1
+done
+
+# The client prints the timings of a script last, on stderr
+submit() {
+    ./rubiee-client "$@" 2>&1 | grep -v -E '^(parse: .*, )?total: [0-9.e+-]+ ms$'
+    return ${PIPESTATUS[0]}
+}
+
+for script in test/parse/*.rb; do
+    bison_out=$(./main --dump-ast "$script" 2>&1; echo "exit $?")
+    pratt_out=$(./main --pratt --dump-ast "$script" 2>&1; echo "exit $?")
+    if [ "$bison_out" != "$pratt_out" ]; then
+        fail "$script: front ends differ"
+        diff <(echo "$bison_out") <(echo "$pratt_out")
+    elif [ -f "${script%.rb}.expected" ] && [ "$bison_out" != "$(cat "${script%.rb}.expected")" ]; then
+        fail "$script: unexpected output"
+        diff "${script%.rb}.expected" <(echo "$bison_out")
+    fi
+done
+
+for script in test/run/*.rb; do
+    for front_end in "" --pratt; do
+        out=$(./main $front_end "$script" 2>&1)
+        if [ "$out" != "$(cat "${script%.rb}.out")" ]; then
+            fail "$script $front_end: unexpected output"
+            diff "${script%.rb}.out" <(echo "$out")
+        fi
+
+        out=$(submit $front_end "$socket" "$script")
+        if [ "$out" != "$(cat "${script%.rb}.out")" ]; then
+            fail "$script $front_end through the server: unexpected output"
+            diff "${script%.rb}.out" <(echo "$out")
+        fi
+    done
+done
+
+for test in test/run/*.sh; do
+    out=$("$test" 2>&1)
+    if [ "$out" != "$(cat "${test%.sh}.out")" ]; then
+        fail "$test: unexpected output"
+        diff "${test%.sh}.out" <(echo "$out")
+    fi
+done
+
+# A script running past the timeout is killed
+printf 'for i = 0; i < 1; i = 0\n  i\nend\n' > "$workdir/loop.rb"
+out=$(submit "$timeout_socket" "$workdir/loop.rb")
+status=$?
+if [ $status -ne 137 ] || [ "$out" != "Script timed out after 1 seconds." ]; then
+    fail "timeout: status $status, $out"
+fi
+
+if ! test/embed; then
+    fail "test/embed"
+fi
+
+if [ $failures -ne 0 ]; then
+    echo "$failures failed"
+    exit 1
+fi
+echo "All tests passed"
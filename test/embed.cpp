@@ -0,0 +1,88 @@
+#include <stdio.h>
+#include "rubiee.h"
+#include "runtime.h"
+
+// A host of `librubiee.a`, run by `make check`: it registers a function,
+// compiles a script once and calls its entry points many times, then compiles
+// and frees other scripts on the same engine.
+
+static double price(int id) {
+    return id * 0.5 + 1;
+}
+
+static const char *SOURCE =
+    "def score(id, weight)\n"
+    "  price(id) * weight\n"
+    "end\n"
+    "def fib(n)\n"
+    "  if n < 2\n"
+    "    n\n"
+    "  else\n"
+    "    fib(n - 1) + fib(n - 2)\n"
+    "  end\n"
+    "end\n";
+
+int main() {
+    Rubiee::Engine engine;
+    if (!engine.registerFunction("price", &price, Rubiee::BUILTIN_PURE)) {
+        return 1;
+    }
+
+    auto script = engine.compile(SOURCE, {
+        Rubiee::Engine::entry<double(int, double)>("score"),
+        Rubiee::Engine::entry<long long(long long)>("fib")
+    });
+    if (!script) {
+        return 1;
+    }
+    script->run();
+
+    auto score = script->function<double(int, double)>("score");
+    auto fib = script->function<long long(long long)>("fib");
+    if (!score || !fib) {
+        return 1;
+    }
+
+    double total = 0;
+    for (int id = 0; id < 1000; id++) {
+        total += score(id, 2.0);
+    }
+    if (total != 501500.0) {
+        printf("score: %f instead of 501500\n", total);
+        return 1;
+    }
+
+    // Recursive and pure, so memoized across calls
+    for (long long n = 0; n <= 90; n++) {
+        fib(n);
+    }
+    if (fib(90) != 2880067194370816120LL) {
+        printf("fib(90): %lld instead of 2880067194370816120\n", fib(90));
+        return 1;
+    }
+    std::string big = Rubiee::formatInteger(fib(100));
+    if (big != "354224848179261915075") {
+        printf("fib(100): %s instead of 354224848179261915075\n", big.c_str());
+        return 1;
+    }
+
+    // Scripts of an engine share its JIT, functions of the same name do not
+    // clash, and freeing a script leaves the others running
+    auto other = engine.compile("def fib(n)\n  n * 2\nend\n", {
+        Rubiee::Engine::entry<long long(long long)>("fib")
+    });
+    if (!other) {
+        return 1;
+    }
+    auto double_it = other->function<long long(long long)>("fib");
+    if (!double_it || double_it(21) != 42 || fib(10) != 55) {
+        printf("two scripts named a function `fib`, calls went to the wrong one\n");
+        return 1;
+    }
+    script.reset();
+    if (double_it(50) != 100) {
+        printf("freeing a script broke another one\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,7 @@
+a = 1 + 2 * 3 - 4
+b = a * a + a * 2 - 1 < 10 == 1
+c = 2147483647 * 0
+e = b >= c
+f = c <= a
+g = a > b
+puts(a, b, c, e, f, g)
@@ -0,0 +1,16 @@
+x = 1
+y = 2
+x = y
+(1..3).each do |i|
+  puts(i)
+end
+def between (a, b)
+  yield(a)
+  yield
+  (a...b).each do |i|
+    yield(i)
+  end
+end
+between(x, y) do |v|
+  puts(v)
+end
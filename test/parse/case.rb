@@ -0,0 +1,13 @@
+x = case y + 1
+when 1, 2
+  3
+when z
+  4
+  5
+else
+  6
+end
+case x
+when 1
+  puts(x)
+end
@@ -0,0 +1,13 @@
+x = 0
+if x < 1
+  puts(1)
+end
+if x == 0 puts(2) else puts(3) end
+for i = 0; i < 10; i = i + 1
+  x = x + i
+  if i > 5
+    x = x * 2
+  else
+    for j = i; j > 0; j = j - 1 x = x - j end
+  end
+end
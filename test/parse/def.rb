@@ -0,0 +1,8 @@
+def add(a, b)
+  c = a + b
+  c * 2
+end
+memo def fib(n)
+  if n < 2 n else fib(n - 1) + fib(n - 2) end
+end
+puts(add(1, 2), fib(10))
@@ -0,0 +1 @@
+puts(9223372036854775808)
@@ -0,0 +1,2 @@
+if x < 1
+  x = x + 1
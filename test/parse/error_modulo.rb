@@ -0,0 +1 @@
+a = 7 % 2
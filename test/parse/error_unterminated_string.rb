@@ -0,0 +1,2 @@
+require "lib/math
+puts(1)
@@ -0,0 +1,2 @@
+x = 1.5 + 0.25e3
+puts(x, 2.0E-2, 10, 3000000000)
@@ -0,0 +1,7 @@
+sum_of_ints = 0
+while_reading = has_int(1)
+for x = 0; has_int(1) == 1; x = 0
+  sum_of_ints = sum_of_ints + read_int(1)
+end
+values = read_ints(0)
+puts(sum_of_ints, array_get(values, array_size(values) - 1), while_reading)
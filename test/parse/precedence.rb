@@ -0,0 +1,7 @@
+a = 1 - 2 - 3 - 4
+b = 2 * 3 * 4 - 5 * 6 * 7
+c = 1 + 2 * 3 + 4 * 5 * 6 - 7
+d = 1 < 2 < 3 == 4 > 5 >= 6 <= 7
+e = 1 + 2 < 3 * 4 == 5 - 6 * 7
+f = g = h = 1 + 2 * 3 < 4
+puts(a - b - c, a * b - c * d, e == f == g)
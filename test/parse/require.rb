@@ -0,0 +1,2 @@
+a = require "lib/math"
+puts(a)
@@ -0,0 +1,16 @@
+def twice (a)
+  yield (a)
+  yield (a + 1)
+end
+puts (1)
+puts (2, 3)
+twice (4) do |v|
+  puts (v)
+end
+x = twice (5) do |v|
+  v * 2
+end
+y = x
+(1..2).each do |i|
+  puts (i, y)
+end
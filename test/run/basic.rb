@@ -0,0 +1,14 @@
+a = 6
+b = a * 7 - 2
+puts(a, b)
+c = if b > 30
+  1
+else
+  0
+end
+puts(c)
+sum = 0
+for i = 0; i < 10; i = i + 1
+  sum = sum + i
+end
+puts(sum)
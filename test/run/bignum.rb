@@ -0,0 +1,21 @@
+def fib(n)
+  if n < 2 n else fib(n - 1) + fib(n - 2) end
+end
+f = 1
+for i = 1; i < 31; i = i + 1
+  f = f * i
+end
+big = 9223372036854775807 * 4
+puts(f, big, big - big * 2, big * big)
+puts(big > f, big < f, big == 9223372036854775807 * 4, big - 9223372036854775807 * 3)
+puts(fib(150), big * 0.5)
+h = hash_new(0)
+hash_set(h, big, 1)
+hash_set(h, 1.0e+20, 2)
+x = big
+for i = 0; i < 300000; i = i + 1
+  x = x + 1
+end
+puts(x, x - big)
+puts(hash_get(h, 9223372036854775807 * 4), hash_get(h, 1.0e+20), hash_has(h, x))
+puts(fib(150) - fib(149), f)
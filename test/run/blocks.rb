@@ -0,0 +1,31 @@
+def twice (x)
+  yield(x)
+  yield (x + 1)
+end
+3.times do |i|
+  puts(i)
+end
+total = 0
+twice(5) do |v|
+  total = total + v
+end
+puts(total)
+count = 0
+4.times do |i|
+  i = 100
+  count = count + 1
+end
+puts(count)
+def pairs(n)
+  (1...n).each do |i|
+    yield(i, i * i)
+  end
+end
+pairs(4) do |a, b|
+  puts(a, b)
+end
+x = 2
+y = x
+(1..2).each do |i|
+  puts(i * y)
+end
@@ -0,0 +1,43 @@
+for i = 0; i < 6; i = i + 1
+  dense = case i
+  when 0
+    10
+  when 1, 2
+    12
+  when 3
+    13
+  when 4
+    14
+  else
+    99
+  end
+  sparse = case i * 1000
+  when 1000
+    1
+  when 5000, 100000
+    5
+  else
+    0
+  end
+  duplicate = case i
+  when 1, 2
+    12
+  when 2, 3
+    23
+  end
+  limit = 2
+  computed = case i
+  when limit, limit + 2
+    7
+  when limit * limit - 1
+    8
+  else
+    9
+  end
+  puts(i, dense, sparse, duplicate, computed)
+end
+missing = case 42
+when 1
+  1
+end
+puts(missing)
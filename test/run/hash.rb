@@ -0,0 +1,36 @@
+h = hash_new(0)
+hash_set(h, 1, 10)
+hash_set(h, 0 - 5, 20)
+hash_set(h, 4294967296, 30)
+puts(hash_get(h, 1), hash_get(h, 0 - 5), hash_get(h, 4294967296), hash_get(h, 2))
+puts(hash_has(h, 1), hash_has(h, 2), hash_size(h))
+hash_set(h, 1, 11)
+puts(hash_get(h, 1), hash_size(h))
+puts(hash_delete(h, 1), hash_delete(h, 1), hash_has(h, 1), hash_get(h, 1))
+hash_set(h, 1, 12)
+puts(hash_get(h, 1), hash_size(h))
+
+total = 0
+for p = hash_next(h, 0); p > 0; p = hash_next(h, p)
+  total = total + hash_key(h, p) * hash_value(h, p)
+end
+puts(total)
+
+squares = hash_new(0)
+for i = 0; i < 5000; i = i + 1
+  hash_set(squares, i, i * i)
+end
+for i = 0; i < 5000; i = i + 2
+  hash_delete(squares, i)
+end
+found = 0
+sum = 0
+for i = 0; i < 10000; i = i + 1
+  found = found + hash_has(squares, i)
+  sum = sum + hash_get(squares, i)
+end
+puts(hash_size(squares), found, sum)
+
+hash_free(h)
+reused = hash_new(0)
+puts(reused == h, hash_size(reused), hash_get(reused, 1), hash_has(reused, 1))
@@ -0,0 +1,15 @@
+#!/bin/bash
+# Integer input from a data file, from a pipe and from a redirected stdin,
+# which is read from the offset the shell left it at
+dir=test/run/input
+data=$(mktemp /tmp/rubiee-input.XXXXXX)
+trap 'rm -f "$data"' EXIT
+
+./main $dir/print_file.rb $dir/numbers.txt
+cat $dir/numbers.txt | ./main $dir/print.rb
+{ read -r header; ./main $dir/print.rb; } < $dir/numbers.txt
+
+# More than a chunk of 1 MB, so numbers straddle chunks of the pipe
+seq 1 200000 > "$data"
+cat "$data" | ./main $dir/count.rb
+./main $dir/count.rb < "$data"
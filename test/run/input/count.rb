@@ -0,0 +1,14 @@
+a = read_ints(0)
+n = array_size(a)
+wrong = 0
+for i = 0; i < n; i = i + 1
+  if array_get(a, i) == i + 1
+    0
+  else
+    wrong = wrong + 1
+  end
+end
+puts(n, wrong)
+array_free(a)
+b = read_ints(0)
+puts(b - a, array_size(b))
@@ -0,0 +1,3 @@
+for x = 0; has_int(0) == 1; x = 0
+  puts(read_int(0))
+end
@@ -0,0 +1,4 @@
+for x = 0; has_int(1) == 1; x = 0
+  puts(read_int(1))
+end
+puts(has_int(1), read_int(1))
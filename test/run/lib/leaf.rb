@@ -0,0 +1,4 @@
+def leaf_value()
+  30
+end
+puts(leaf_value())
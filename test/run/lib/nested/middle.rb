@@ -0,0 +1,5 @@
+require "../leaf"
+def middle_value(x)
+  leaf_value() - 10 + x
+end
+puts(middle_value(0))
@@ -0,0 +1,2 @@
+require "nested/middle"
+puts(10)
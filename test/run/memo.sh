@@ -0,0 +1,10 @@
+#!/bin/bash
+# Recursive pure functions and pure `memo def`s are memoized, impure ones are
+# not, with a warning. Every specialization has a cache of its own, `add` is
+# called with an `i64` and with `i32`s. `--memo-size` must be a number of at
+# most 1048576.
+dir=test/run/memo
+
+./main --memo-stats $dir/fib.rb
+./main --memo-size=abc $dir/fib.rb 2>&1 | head -1
+./main --memo-size=2000000 $dir/fib.rb 2>&1 | head -1
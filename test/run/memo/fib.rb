@@ -0,0 +1,17 @@
+def fib(n)
+  if n < 2 n else fib(n - 1) + fib(n - 2) end
+end
+memo def add(a, b)
+  a + b
+end
+memo def noisy(n)
+  puts(n)
+  n
+end
+def plain(n)
+  n * 2
+end
+for i = 0; i < 3; i = i + 1
+  puts(fib(25), add(i, 1), add(1, 1), plain(i))
+end
+puts(noisy(7))
@@ -0,0 +1,27 @@
+#!/bin/bash
+# --profile prints a report on stderr and writes collapsed stacks next to the
+# script. Samples vary from run to run, so only their shape is checked.
+dir=$(mktemp -d /tmp/rubiee-profile.XXXXXX)
+trap 'rm -rf "$dir"' EXIT
+cp test/run/profile/loops.rb "$dir"
+
+./main --profile "$dir/loops.rb" 2> "$dir/report"
+
+# The header, the section titles, the loop body among the hot lines and
+# both loops
+grep -E '^Profile: [0-9]+ samples, every 1000 us$' "$dir/report" | sed -E 's/[0-9]+ samples/N samples/'
+grep -E '^Hot (lines|loops):$' "$dir/report"
+grep -E '^ +[0-9]+ +[0-9.]+% +4  total = total \+ i \* j$' "$dir/report" | sed -E 's/^ +[0-9]+ +[0-9.]+% +//'
+sed -n '/^Hot loops:$/,$p' "$dir/report" | grep -E '^ +[0-9]+ +[0-9.]+% ' | sed -E 's/^ +[0-9]+ +[0-9.]+% +//' | sort
+
+# Every stack starts at `main` and ends with a line and its samples, and the
+# inner loop keeps the outer one as its caller
+grep -v -E '^main(;for@[0-9]+)*(;line [0-9]+)? [0-9]+$' "$dir/loops.rb.folded"
+grep -E -o '^main;for@2;for@3;line 4 ' "$dir/loops.rb.folded" | sed 's/ $//'
+
+# A function, named after its specialization, keeps the loop it is called
+# from as its caller, and the line of the call gets the samples taken after
+# it returns
+cp test/run/profile/calls.rb "$dir"
+./main --profile "$dir/calls.rb" 2> /dev/null
+grep -E -o '^main;for@9;inner\.i32;for@3;line 4 ' "$dir/calls.rb.folded" | sed 's/ $//'
@@ -0,0 +1,12 @@
+def inner(n)
+  total = 0
+  for i = 0; i < n; i = i + 1
+    total = total + i
+  end
+  total
+end
+sum = 0
+for k = 0; k < 20000; k = k + 1
+  sum = sum + inner(10000)
+end
+puts(sum)
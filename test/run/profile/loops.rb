@@ -0,0 +1,7 @@
+total = 0
+for i = 0; i < 10000; i = i + 1
+  for j = 0; j < 10000; j = j + 1
+    total = total + i * j
+  end
+end
+puts(total)
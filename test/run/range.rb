@@ -0,0 +1,18 @@
+n = 0
+(9223372036854775805..9223372036854775807).each do |i|
+  n = n + 1
+end
+(5..4).each do |i|
+  puts(i)
+end
+(3...3).each do |i|
+  puts(i)
+end
+(1..3).each do |i|
+  puts(i)
+end
+big = 9223372036854775807 + 1
+puts(n, big)
+(1..big).each do |i|
+  puts(i)
+end
@@ -0,0 +1,8 @@
+puts(require "lib/outer")
+puts(require "lib/outer.rb")
+puts(require "lib/leaf")
+def leaf_value()
+  1
+end
+puts(middle_value(5), leaf_value())
+puts(middle_value(2.5))
@@ -0,0 +1,32 @@
+#!/bin/bash
+# Editing the body of a required function compiles its file again, but none
+# of the files requiring it, which are taken from the cache. Changing what a
+# function returns, or adding a function, also compiles the files which see
+# it.
+dir=$(mktemp -d /tmp/rubiee-require.XXXXXX)
+trap 'rm -rf "$dir"' EXIT
+cp -r test/run/require.rb test/run/lib "$dir"
+
+objects() {
+    ls "$dir/.rubiee-cache" | grep '\.o$' | sort
+}
+
+./main "$dir/require.rb" > /dev/null
+objects > "$dir/before"
+echo "$(wc -l < "$dir/before") objects"
+
+sed -i 's/^  30$/  31/' "$dir/lib/leaf.rb"
+./main "$dir/require.rb"
+objects > "$dir/after"
+echo "$(comm -13 "$dir/before" "$dir/after" | wc -l) new"
+
+sed -i 's/^  31$/  31.5/' "$dir/lib/leaf.rb"
+./main "$dir/require.rb"
+objects > "$dir/before"
+echo "$(comm -13 "$dir/after" "$dir/before" | wc -l) new"
+cp "$dir/before" "$dir/after"
+
+printf 'def leaf_twice(x)\n  x * 2\nend\n' >> "$dir/lib/leaf.rb"
+./main "$dir/require.rb" > /dev/null
+objects > "$dir/before"
+echo "$(comm -13 "$dir/after" "$dir/before" | wc -l) new"
@@ -0,0 +1,18 @@
+def twice(x)
+  x + x
+end
+def half(x)
+  x * 0.5
+end
+puts(twice(21), twice(3000000000), twice(1.25))
+puts(half(4000), half(3))
+puts(2000.0, 1.0e+20, 1.5e-7, 0.1 + 0.2)
+puts(100000 * 100000, 3 * 1.5, 7 - 0.5)
+total = 0
+for i = 0; i < 3; i = i + 1
+  total = total + 0.25
+end
+puts(total)
+if 2.5 > 2
+  puts(1)
+end
@@ -0,0 +1,432 @@
+#include <limits>
+#include <stdio.h>
+#include "type_inference.h"
+#include "builtins.h"
+
+Rubiee::NumericType Rubiee::counterType(NumericType first, NumericType last) {
+    return first == INT32 && last == INT32 ? INT32 : INT64;
+}
+
+const char *Rubiee::numericTypeName(NumericType type) {
+    switch (type) {
+    case INT32: return "i32";
+    case INT64: return "i64";
+    case DOUBLE: return "f64";
+    }
+    return "";
+}
+
+static Rubiee::NumericType largerType(Rubiee::NumericType a, Rubiee::NumericType b) {
+    return a > b ? a : b;
+}
+
+Rubiee::TypeInference::TypeInference()
+                                     : top_level_nodes(nullptr), current(nullptr), inline_frame(nullptr),
+                                       changed(false), result(INT32) {
+    top_level.function = nullptr;
+    top_level.return_type = INT32;
+}
+
+std::vector<Rubiee::TypeInference::Signature> Rubiee::TypeInference::exportedSignatures(unsigned arg_num) {
+    std::vector<Signature> signatures;
+    if (arg_num > MAX_MIXED_EXPORT_ARGS) {
+        signatures.push_back(Signature(arg_num, INT64));
+        signatures.push_back(Signature(arg_num, DOUBLE));
+        return signatures;
+    }
+
+    // Bit `i` of the index is set when argument `i` is a `DOUBLE`
+    for (unsigned index = 0; index < (1u << arg_num); index++) {
+        Signature signature;
+        for (unsigned i = 0; i < arg_num; i++) {
+            signature.push_back(index & (1u << i) ? DOUBLE : INT64);
+        }
+        signatures.push_back(signature);
+    }
+    return signatures;
+}
+
+unsigned Rubiee::TypeInference::exportedIndex(const Signature &arg_types) {
+    unsigned index = 0;
+    for (unsigned i = 0; i < arg_types.size(); i++) {
+        if (arg_types[i] == DOUBLE) {
+            index |= arg_types.size() > MAX_MIXED_EXPORT_ARGS ? 1 : 1u << i;
+        }
+    }
+    return index;
+}
+
+std::string Rubiee::TypeInference::specializationName(const std::string &name, const Signature &arg_types) {
+    std::string specialization_name = name;
+    for (auto type = arg_types.begin(); type != arg_types.end(); ++type) {
+        specialization_name += std::string(".") + numericTypeName(*type);
+    }
+    return specialization_name;
+}
+
+void Rubiee::TypeInference::addImport(const std::string &name, const std::vector<NumericType> &return_types) {
+    imports[name] = return_types;
+}
+
+const std::vector<Rubiee::NumericType> *Rubiee::TypeInference::importOf(const std::string &name) const {
+    auto function = imports.find(name);
+    return function == imports.end() ? nullptr : &function->second;
+}
+
+void Rubiee::TypeInference::addEntry(const std::string &name, const Signature &arg_types) {
+    entries.push_back(std::make_pair(name, arg_types));
+}
+
+void Rubiee::TypeInference::exportFunctions(std::vector<ASTNode*> &nodes) {
+    for (unsigned i = 0; i < nodes.size(); i++) {
+        Function *function = dynamic_cast<Function *>(nodes[i]);
+        if (!function) {
+            continue;
+        }
+        std::vector<Signature> signatures = exportedSignatures(function->proto->args.size());
+        for (auto signature = signatures.begin(); signature != signatures.end(); ++signature) {
+            addEntry(function->proto->name, *signature);
+        }
+    }
+}
+
+void Rubiee::TypeInference::addHostFunction(const std::string &name, NumericType return_type) {
+    host_functions[name] = return_type;
+}
+
+const Rubiee::TypeInference::Specialization &Rubiee::TypeInference::topLevel() const {
+    return top_level;
+}
+
+const Rubiee::TypeInference::Specialization *Rubiee::TypeInference::find(const std::string &name, const Signature &arg_types) const {
+    auto specialization = specializations.find(std::make_pair(name, arg_types));
+    return specialization == specializations.end() ? nullptr : &specialization->second;
+}
+
+std::vector<const Rubiee::TypeInference::Specialization*> Rubiee::TypeInference::specializationsOf(const std::string &name) const {
+    std::vector<const Specialization*> found;
+    for (auto specialization = specializations.lower_bound(std::make_pair(name, Signature()));
+         specialization != specializations.end() && specialization->first.first == name;
+         ++specialization) {
+        found.push_back(&specialization->second);
+    }
+    return found;
+}
+
+Rubiee::Function *Rubiee::TypeInference::definition(const std::string &name) const {
+    auto function = definitions.find(name);
+    return function == definitions.end() ? nullptr : function->second;
+}
+
+std::string Rubiee::TypeInference::inlineScope(const std::string &caller_scope, const FunctionCall &call) {
+    // Identifiers cannot contain `@` or `/`, and every call site gets its own
+    // variables, so that a block can call the function it is given to
+    char site[32];
+    snprintf(site, sizeof(site), "@%p/", (const void *) &call);
+    return caller_scope + call.callee + site;
+}
+
+bool Rubiee::TypeInference::isInlined(const InlineFrame *frame, const Function *function) {
+    for (; frame; frame = frame->caller) {
+        if (frame->function == function) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void Rubiee::TypeInference::analyze(std::vector<ASTNode*> &nodes) {
+    top_level_nodes = &nodes;
+
+    // Functions can be called before their definition
+    for (unsigned i = 0; i < nodes.size(); i++) {
+        if (Function *function = dynamic_cast<Function *>(nodes[i])) {
+            definitions.insert(std::make_pair(function->proto->name, function));
+        }
+    }
+
+    // Entries of undefined functions are reported by the code generation
+    for (auto entry = entries.begin(); entry != entries.end(); ++entry) {
+        Function *function = definition(entry->first);
+        if (function && function->proto->args.size() == entry->second.size()) {
+            specialize(function, entry->second);
+        }
+    }
+
+    // New specializations are found, and return types get larger, until
+    // nothing changes
+    do {
+        changed = false;
+        analyzeSpecialization(top_level);
+        for (auto specialization = specializations.begin(); specialization != specializations.end(); ++specialization) {
+            analyzeSpecialization(specialization->second);
+        }
+    } while (changed);
+}
+
+Rubiee::TypeInference::Specialization &Rubiee::TypeInference::specialize(Function *function, const Signature &arg_types) {
+    auto key = std::make_pair(function->proto->name, arg_types);
+    auto specialization = specializations.find(key);
+    if (specialization == specializations.end()) {
+        Specialization created;
+        created.function = function;
+        created.arg_types = arg_types;
+        created.name = specializationName(function->proto->name, arg_types);
+        // Return types start from the smallest type and grow from there
+        created.return_type = INT32;
+        specialization = specializations.insert(std::make_pair(key, created)).first;
+        changed = true;
+    }
+    return specialization->second;
+}
+
+void Rubiee::TypeInference::analyzeSpecialization(Specialization &specialization) {
+    current = &specialization;
+    scope.clear();
+    inline_frame = nullptr;
+
+    NumericType return_type;
+    std::map<std::string, NumericType> variables;
+    do {
+        variables = specialization.variables;
+
+        if (specialization.function) {
+            std::vector<std::string> &args = specialization.function->proto->args;
+            for (unsigned i = 0; i < args.size(); i++) {
+                assign(args[i], specialization.arg_types[i]);
+            }
+            return_type = inferAll(specialization.function->body_exprs);
+        } else {
+            for (unsigned i = 0; i < top_level_nodes->size(); i++) {
+                ((*top_level_nodes)[i])->accept(*this);
+            }
+        }
+    } while (specialization.variables != variables);
+
+    if (specialization.function && return_type > specialization.return_type) {
+        specialization.return_type = return_type;
+        changed = true;
+    }
+
+    current = nullptr;
+}
+
+Rubiee::NumericType Rubiee::TypeInference::infer(Expr *expr) {
+    expr->accept(*this);
+
+    // Inlined bodies and blocks are typed once per call and `yield`, the
+    // generated code holds the largest type
+    auto type = current->exprs.find(expr);
+    if (type == current->exprs.end()) {
+        current->exprs[expr] = result;
+    } else {
+        type->second = largerType(type->second, result);
+    }
+    return result;
+}
+
+Rubiee::NumericType Rubiee::TypeInference::inferAll(std::vector<Expr*> &exprs) {
+    // An empty sequence is `0`
+    result = INT32;
+
+    for (auto expr = exprs.begin(); expr != exprs.end(); ++expr) {
+        infer(*expr);
+    }
+    return result;
+}
+
+void Rubiee::TypeInference::assign(const std::string &name, NumericType type) {
+    auto variable = current->variables.find(name);
+    if (variable == current->variables.end()) {
+        current->variables[name] = type;
+    } else {
+        variable->second = largerType(variable->second, type);
+    }
+}
+
+void Rubiee::TypeInference::visit(Expr &expr) {}
+void Rubiee::TypeInference::visit(Statement &stmt) {}
+void Rubiee::TypeInference::visit(FunctionPrototype &function_prototype) {}
+
+void Rubiee::TypeInference::visit(IntConst &int_const) {
+    bool fits = int_const.val >= std::numeric_limits<int>::min() && int_const.val <= std::numeric_limits<int>::max();
+    result = fits ? INT32 : INT64;
+}
+
+void Rubiee::TypeInference::visit(FloatConst &float_const) {
+    result = DOUBLE;
+}
+
+void Rubiee::TypeInference::visit(BinaryExpr &binary_expr) {
+    NumericType lhs = infer(binary_expr.leftOperand);
+    NumericType rhs = infer(binary_expr.rightOperand);
+
+    // Integer arithmetic is done on 64 bits, and overflows into bignums
+    result = largerType(largerType(lhs, rhs), INT64);
+}
+
+void Rubiee::TypeInference::visit(ComparisonExpr &comparison_expr) {
+    infer(comparison_expr.leftOperand);
+    infer(comparison_expr.rightOperand);
+    result = INT32;
+}
+
+void Rubiee::TypeInference::visit(IfExpr &if_expr) {
+    infer(if_expr.condition);
+
+    NumericType then_type = inferAll(if_expr.then_exprs);
+    NumericType else_type = inferAll(if_expr.else_exprs);
+
+    result = largerType(then_type, else_type);
+}
+
+void Rubiee::TypeInference::visit(CaseExpr &case_expr) {
+    infer(case_expr.subject);
+
+    NumericType type = inferAll(case_expr.else_exprs);
+    for (auto when = case_expr.whens.begin(); when != case_expr.whens.end(); ++when) {
+        for (auto value = when->values.begin(); value != when->values.end(); ++value) {
+            infer(*value);
+        }
+        type = largerType(type, inferAll(when->body_exprs));
+    }
+
+    result = type;
+}
+
+void Rubiee::TypeInference::visit(ForLoopExpr &for_loop_expr) {
+    infer(for_loop_expr.start_expr);
+    infer(for_loop_expr.continue_condition);
+    inferAll(for_loop_expr.body_exprs);
+    infer(for_loop_expr.step_expr);
+
+    // A loop is `0`
+    result = INT32;
+}
+
+void Rubiee::TypeInference::visit(RangeLoopExpr &range_loop_expr) {
+    NumericType first = infer(range_loop_expr.first);
+    NumericType last = infer(range_loop_expr.last);
+
+    // The block parameter counts from `first` to `last`, extra parameters are `0`
+    std::vector<std::string> &params = range_loop_expr.block->params;
+    for (unsigned i = 0; i < params.size(); i++) {
+        assign(scope + params[i], i == 0 ? counterType(first, last) : INT32);
+    }
+    inferAll(range_loop_expr.block->body_exprs);
+
+    // A loop is `0`
+    result = INT32;
+}
+
+void Rubiee::TypeInference::visit(YieldExpr &yield_expr) {
+    Signature arg_types;
+    for (auto arg = yield_expr.args.begin(); arg != yield_expr.args.end(); ++arg) {
+        arg_types.push_back(infer(*arg));
+    }
+
+    // `yield` without a block is reported by the code generation
+    const InlineFrame *frame = inline_frame;
+    if (!frame) {
+        result = INT32;
+        return;
+    }
+
+    // The block runs where it was written, parameters without an argument are `0`
+    std::string callee_scope = scope;
+    scope = frame->caller_scope;
+    inline_frame = frame->caller;
+
+    std::vector<std::string> &params = frame->block->params;
+    for (unsigned i = 0; i < params.size(); i++) {
+        assign(scope + params[i], i < arg_types.size() ? arg_types[i] : INT32);
+    }
+    inferAll(frame->block->body_exprs);
+
+    scope = callee_scope;
+    inline_frame = frame;
+}
+
+void Rubiee::TypeInference::visit(Variable &var) {
+    auto variable = current->variables.find(scope + var.name);
+    result = variable == current->variables.end() ? INT32 : variable->second;
+}
+
+void Rubiee::TypeInference::visit(VariableAssignment &var_assignment) {
+    assign(scope + var_assignment.var->name, infer(var_assignment.expr));
+
+    // The value of an assignment is the variable
+    infer(var_assignment.var);
+}
+
+void Rubiee::TypeInference::visit(FunctionCall &function_call) {
+    Signature arg_types;
+    for (auto arg = function_call.args.begin(); arg != function_call.args.end(); ++arg) {
+        arg_types.push_back(infer(*arg));
+    }
+
+    // Calls to undefined functions are reported by the code generation
+    result = INT32;
+
+    // Builtins win over functions of the same name
+    if (const Builtin *builtin = findBuiltin(function_call.callee)) {
+        result = builtin->return_type;
+        return;
+    }
+    auto host_function = host_functions.find(function_call.callee);
+    if (host_function != host_functions.end()) {
+        result = host_function->second;
+        return;
+    }
+
+    Function *function = definition(function_call.callee);
+    if (!function) {
+        // Functions of other files are called through the specialization
+        // they export for the arguments
+        const std::vector<NumericType> *return_types = importOf(function_call.callee);
+        unsigned index = exportedIndex(arg_types);
+        if (return_types && index < return_types->size()) {
+            result = (*return_types)[index];
+        }
+        return;
+    }
+    if (function->proto->args.size() != arg_types.size()) {
+        return;
+    }
+
+    // Functions given a block are inlined, recursive ones are reported by the
+    // code generation
+    if (function_call.block) {
+        if (isInlined(inline_frame, function)) {
+            return;
+        }
+
+        InlineFrame frame = { function, function_call.block, scope, inline_frame };
+        scope = inlineScope(scope, function_call);
+        inline_frame = &frame;
+
+        std::vector<std::string> &args = function->proto->args;
+        for (unsigned i = 0; i < args.size(); i++) {
+            assign(scope + args[i], arg_types[i]);
+        }
+        NumericType type = inferAll(function->body_exprs);
+
+        scope = frame.caller_scope;
+        inline_frame = frame.caller;
+        result = type;
+        return;
+    }
+
+    result = specialize(function, arg_types).return_type;
+}
+
+void Rubiee::TypeInference::visit(Require &require) {
+    result = INT32;
+}
+
+void Rubiee::TypeInference::visit(TopLevelExpr &top_level_expr) {
+    infer(top_level_expr.expr);
+}
+
+// Functions are typed per specialization, see `analyzeSpecialization`
+void Rubiee::TypeInference::visit(Function &function) {}
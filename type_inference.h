@@ -0,0 +1,162 @@
+#ifndef __TYPE_INFERENCE_H__
+#define __TYPE_INFERENCE_H__ 1
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include "ast.h"
+#include "ast_visitor.h"
+
+namespace Rubiee {
+
+// Numeric types, ordered so that the type holding both of two types is the
+// larger one
+enum NumericType { INT32, INT64, DOUBLE };
+
+// Name used for `type` in the symbols of specializations, e.g. `i64`
+const char *numericTypeName(NumericType type);
+
+// Type of the counter of a range from `first` to `last`, floats are truncated
+NumericType counterType(NumericType first, NumericType last);
+
+// Assigns a numeric type to every variable and expression.
+//
+// Functions are typed once per signature, i.e. the types of the arguments
+// they are called with, and every signature becomes a specialization of its
+// own. Types are the narrowest that can hold every value:
+//
+//   - Integer constants are `INT32` if they fit, `INT64` otherwise, and
+//     floating point constants are `DOUBLE`.
+//   - Arithmetic takes the larger type of its operands, and is at least
+//     `INT64`: integer arithmetic is done on 64 bits, and results which do not
+//     fit become bignums, see `CodeGenVisitor::generateCheckedArithmetic`.
+//   - A variable takes the larger type of every value assigned to it.
+//   - Functions called with a block are inlined, their variables are typed
+//     in a scope of their own within the caller, see `inlineScope`.
+//
+// Types only ever get larger, so repeating the analysis until nothing changes
+// terminates, with at most one change per variable and type.
+class TypeInference : public ASTNodeVisitor {
+
+public:
+    typedef std::vector<NumericType> Signature;
+
+    struct Specialization {
+        // Definition, `nullptr` for the top level expressions
+        Function *function;
+        Signature arg_types;
+        // Symbol of the specialization, e.g. `fib.i64`
+        std::string name;
+        NumericType return_type;
+        std::map<std::string, NumericType> variables;
+        std::map<const Expr*, NumericType> exprs;
+    };
+
+    // A function being inlined because it was called with a block, `yield`
+    // goes back to `caller_scope` to run the block
+    struct InlineFrame {
+        Function *function;
+        Block *block;
+        std::string caller_scope;
+        const InlineFrame *caller;
+    };
+
+    TypeInference();
+
+    // Functions called from other files are specialized for these signatures,
+    // whoever calls them: every argument is `INT64` or `DOUBLE`. Functions of
+    // more than `MAX_MIXED_EXPORT_ARGS` arguments only take all `INT64` or all
+    // `DOUBLE` arguments.
+    static std::vector<Signature> exportedSignatures(unsigned arg_num);
+    static const unsigned MAX_MIXED_EXPORT_ARGS = 4;
+    // Index in `exportedSignatures` of the specialization called with
+    // `arg_types` from another file, arguments are converted to its types
+    static unsigned exportedIndex(const Signature &arg_types);
+    // Symbol of the specialization of `name` for `arg_types`
+    static std::string specializationName(const std::string &name, const Signature &arg_types);
+
+    // Let the code call `name`, defined by another file, with the return type
+    // of every signature in `exportedSignatures`. Functions defined by the
+    // code win over it.
+    void addImport(const std::string &name, const std::vector<NumericType> &return_types);
+    // Return types of the function `name` defined by another file, `nullptr`
+    // if it is not imported
+    const std::vector<NumericType> *importOf(const std::string &name) const;
+    // Specialize `name` for `arg_types` even if the code never calls it, so
+    // that other files can call it
+    void addEntry(const std::string &name, const Signature &arg_types);
+    // Add an entry for every function of `nodes` and signature in
+    // `exportedSignatures`
+    void exportFunctions(std::vector<ASTNode*> &nodes);
+    // Let scripts call the host function `name`, see `rubiee.h`. Like
+    // builtins, host functions win over functions of the same name.
+    void addHostFunction(const std::string &name, NumericType return_type);
+
+    // Type the top level expressions of `nodes`, and every specialization of
+    // the functions they define which can be reached from there or from an
+    // entry
+    void analyze(std::vector<ASTNode*> &nodes);
+
+    const Specialization &topLevel() const;
+    // Specialization of `name` for `arg_types`, `nullptr` if it is not called
+    const Specialization *find(const std::string &name, const Signature &arg_types) const;
+    std::vector<const Specialization*> specializationsOf(const std::string &name) const;
+    // First definition of `name`, `nullptr` if there is none
+    Function *definition(const std::string &name) const;
+
+    // Prefix of the variables of the function inlined at `call`. Variables of
+    // the top level and of specializations have no prefix.
+    static std::string inlineScope(const std::string &caller_scope, const FunctionCall &call);
+    // Whether `function` is already being inlined in `frame`, inlining it
+    // again would never end
+    static bool isInlined(const InlineFrame *frame, const Function *function);
+
+    void visit(Expr &expr);
+    void visit(Statement &stmt);
+    void visit(IntConst &int_const);
+    void visit(FloatConst &float_const);
+    void visit(BinaryExpr &binary_expr);
+    void visit(ComparisonExpr &comparison_expr);
+    void visit(IfExpr &if_expr);
+    void visit(CaseExpr &case_expr);
+    void visit(ForLoopExpr &for_loop_expr);
+    void visit(RangeLoopExpr &range_loop_expr);
+    void visit(YieldExpr &yield_expr);
+    void visit(Variable &var);
+    void visit(VariableAssignment &var_assignment);
+    void visit(FunctionCall &function_call);
+    void visit(Require &require);
+    void visit(FunctionPrototype &function_prototype);
+    void visit(TopLevelExpr &top_level_expr);
+    void visit(Function &function);
+
+private:
+    std::map<std::string, Function*> definitions;
+    std::map<std::pair<std::string, Signature>, Specialization> specializations;
+    std::map<std::string, std::vector<NumericType>> imports;
+    std::map<std::string, NumericType> host_functions;
+    std::vector<std::pair<std::string, Signature>> entries;
+    Specialization top_level;
+    std::vector<ASTNode*> *top_level_nodes;
+
+    // State of the specialization being typed
+    Specialization *current;
+    std::string scope;
+    const InlineFrame *inline_frame;
+    bool changed;
+
+    // Type of the last expression typed
+    NumericType result;
+
+    // Specialization of `function` for `arg_types`, created if it is new
+    Specialization &specialize(Function *function, const Signature &arg_types);
+    void analyzeSpecialization(Specialization &specialization);
+    NumericType infer(Expr *expr);
+    NumericType inferAll(std::vector<Expr*> &exprs);
+    void assign(const std::string &name, NumericType type);
+};
+
+}
+
+#endif